@@ -26,184 +26,2309 @@ SOFTWARE.
 
 #include <random>
 #include <thread>
+#include <atomic>
 #include <mutex>
-#include <condition_variable>
+#include <chrono>
+#include <limits>
 #include <vector>
 #include <array>
 #include <memory>
 #include <algorithm>
 #include <ranges>
 #include <optional>
-#include <functional>
+#include <concepts>
 #include <stdexcept>
+#include <span>
+#include <iterator>
+#include <string>
+#include <fstream>
+#include <new>
+#include <cstdint>
 #include <cassert>
 
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 namespace threaded_rng_cache
 {
+    inline constexpr size_t CACHE_LINE_SIZE = 64;
+
+    // Where to run the producer threads relative to the thread constructing the cache, which is taken to be
+    // the consumer. Placement is only applied on Linux and is otherwise ignored.
+    struct Affinity {
+        enum class Policy {
+            // Leave placement to the scheduler.
+            None,
+            // Pin the producer threads to the CPUs in cpus, one CPU each, in turn.
+            CpuList,
+            // Let the producers run anywhere except on the physical core of the consumer.
+            AvoidConsumerCore,
+            // Pin the producers to the SMT siblings of the consumer's CPU, sharing its L1 and L2 caches.
+            ConsumerSibling,
+            // Pin the producers to one hardware thread per physical core, the consumer's core last.
+            OnePerPhysicalCore,
+        };
+
+        Policy policy = Policy::None;
+        std::vector<unsigned> cpus;
+    };
+
+    // Which NUMA nodes the chunk memory is placed on. Chunk memory is never touched before a producer fills it,
+    // so without a policy each chunk lands on the node of the producer that first fills it. Like Affinity this
+    // is only applied on Linux.
+    struct Numa {
+        enum class Policy {
+            // Leave placement to the first touch by the producers.
+            FirstTouch,
+            // Place all chunks on the node the cache is constructed on and, unless an Affinity policy is
+            // given, keep the producers on that node's CPUs as well.
+            ConsumerNode,
+            // Spread the pages of every chunk evenly over all nodes with memory.
+            Interleave,
+        };
+
+        Policy policy = Policy::FirstTouch;
+        // Record in Statistics on which nodes the received chunks reside. Costs a few system calls per swap, and is
+        // therefore skipped for NonBlockingWait consumers.
+        bool statistics = false;
+    };
+
+    // Backing the chunks with 2 MiB huge pages cuts the TLB misses of sweeping through fresh chunks. Chunks are
+    // then carved out of huge page sized blocks, so memory usage rounds up to whole blocks. When huge pages are
+    // unavailable the cache falls back to transparent huge pages and then to regular pages.
+    enum class HugePages {
+        // Regular pages, mapped separately for each chunk.
+        None,
+        // Blocks advised with MADV_HUGEPAGE, which the kernel backs with huge pages when it can.
+        Transparent,
+        // Blocks mapped with MAP_HUGETLB from the reserved huge page pool. Needs an allocator providing
+        // allocate_huge, like PageAllocator, and is treated as Transparent otherwise.
+        Explicit,
+    };
+
+    // The order in which the consumers receive the producers' chunks.
+    enum class Ordering {
+        // Strictly round-robin over the producers, which makes the output deterministic given a seed.
+        RoundRobin,
+        // Whichever chunk is ready first, so that a slow or descheduled producer does not hold up the consumers
+        // while the others have chunks ready. The output then depends on timing.
+        Unordered,
+        // In round-robin order, but with each chunk filled by whichever producer is free from an engine seeded
+        // for the chunk's index in the sequence, so that the output is deterministic given a seed while a
+        // descheduled producer only delays the one chunk it is filling. Differs from the round-robin output.
+        Sequenced,
+    };
+
+    namespace detail
+    {
+        // Parses a kernel CPU list such as "0-3,8,10-11".
+        inline std::vector<unsigned>
+        parseCpuList(const std::string& list) {
+            std::vector<unsigned> cpus;
+            size_t begin = 0;
+            while (begin < list.size()) {
+                const size_t end = std::min(list.find(',', begin), list.size());
+                const std::string range = list.substr(begin, end - begin);
+                const size_t dash = range.find('-');
+                if (!range.empty()) {
+                    const unsigned first = static_cast<unsigned>(std::stoul(range.substr(0, dash)));
+                    const unsigned last = dash == std::string::npos
+                        ? first
+                        : static_cast<unsigned>(std::stoul(range.substr(dash + 1)));
+                    for (unsigned cpu = first; cpu <= last; ++cpu) {
+                        cpus.push_back(cpu);
+                    }
+                }
+                begin = end + 1;
+            }
+            return cpus;
+        }
+
+        inline std::optional<std::string>
+        readLine(const std::string& path) {
+            std::ifstream file{path};
+            std::string line;
+            if (!std::getline(file, line)) {
+                return std::nullopt;
+            }
+            return line;
+        }
+
+        inline std::string
+        cpuPath(unsigned cpu, const std::string& file) {
+            return "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/" + file;
+        }
+
+        inline std::vector<unsigned>
+        onlineCpus() {
+            const std::optional<std::string> online = readLine("/sys/devices/system/cpu/online");
+            return online ? parseCpuList(*online) : std::vector<unsigned>{};
+        }
+
+        // The hardware threads sharing a physical core with the given CPU, including itself.
+        inline std::vector<unsigned>
+        coreSiblings(unsigned cpu) {
+            const std::optional<std::string> siblings = readLine(cpuPath(cpu, "topology/thread_siblings_list"));
+            return siblings ? parseCpuList(*siblings) : std::vector<unsigned>{cpu};
+        }
+
+        // Tells the CPU that the thread is spinning, which saves power and lets a sibling hardware thread,
+        // possibly the producer being waited for, run faster.
+        inline void
+        pause() {
+#if defined(__x86_64__) || defined(__i386__)
+            _mm_pause();
+#elif defined(__aarch64__)
+            asm volatile("yield");
+#endif
+        }
+
+        // Finalizer of the SplitMix64 generator, which spreads every bit of x over all bits of the result.
+        constexpr uint64_t
+        splitMix64(uint64_t x) {
+            x += 0x9e3779b97f4a7c15;
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+            return x ^ (x >> 31);
+        }
+
+        // Calls done until it returns true or the deadline passes, spinning at first and then sleeping for
+        // growing intervals in between. Returns whether done returned true.
+        template<typename ClockT, typename DurationT, std::predicate<> DoneT>
+        bool
+        pollUntil(const std::chrono::time_point<ClockT, DurationT>& deadline, DoneT&& done) {
+            constexpr size_t spins = 1024;
+            constexpr std::chrono::microseconds maxSleep{64};
+            std::chrono::microseconds sleep{1};
+            for (size_t attempt = 0;; ++attempt) {
+                if (done()) {
+                    return true;
+                }
+                const auto now = ClockT::now();
+                if (now >= deadline) {
+                    return false;
+                }
+                if (attempt < spins) {
+                    pause();
+                } else {
+                    const auto wakeUp = now + sleep;
+                    std::this_thread::sleep_until(wakeUp < deadline ? wakeUp : deadline);
+                    sleep = std::min(2 * sleep, maxSleep);
+                }
+            }
+        }
+
+        // Size in bytes of the level 2 data or unified cache of the first CPU, if the kernel reports one.
+        inline std::optional<size_t>
+        l2CacheSize() {
+            for (unsigned index = 0;; ++index) {
+                const std::string cache = "cache/index" + std::to_string(index) + "/";
+                const std::optional<std::string> level = readLine(cpuPath(0, cache + "level"));
+                if (!level) {
+                    return std::nullopt;
+                }
+                const std::optional<std::string> type = readLine(cpuPath(0, cache + "type"));
+                const std::optional<std::string> size = readLine(cpuPath(0, cache + "size"));
+                if (*level == "2" && type && *type != "Instruction" && size && !size->empty()) {
+                    const size_t value = std::stoull(*size);
+                    switch (size->back()) {
+                        case 'K': return value * 1024;
+                        case 'M': return value * 1024 * 1024;
+                        default: return value;
+                    }
+                }
+            }
+        }
+
+        // The chunk size in bytes of caches choosing it at runtime: a quarter of the L2 cache, which is where
+        // the 128 KiB default of the fixed size comes from, or 128 KiB if the L2 size is unknown.
+        inline size_t
+        defaultChunkBytes() {
+            static const size_t bytes = l2CacheSize().value_or(512 * 1024) / 4;
+            return bytes;
+        }
+
+        inline std::optional<unsigned>
+        currentCpu() {
+#if defined(__linux__)
+            const int cpu = sched_getcpu();
+            if (cpu >= 0) {
+                return static_cast<unsigned>(cpu);
+            }
+#endif
+            return std::nullopt;
+        }
+
+        // The CPUs each of count threads should be restricted to according to the policy, an empty set
+        // meaning no restriction.
+        inline std::vector<std::vector<unsigned>>
+        placement(const Affinity& affinity, size_t count) {
+            std::vector<std::vector<unsigned>> sets(count);
+            const std::vector<unsigned> online = onlineCpus();
+            const std::optional<unsigned> consumer = currentCpu();
+
+            const auto assignInTurn = [&](const std::vector<unsigned>& cpus) {
+                for (size_t i = 0; i < count && !cpus.empty(); ++i) {
+                    sets[i] = {cpus[i % cpus.size()]};
+                }
+            };
+
+            switch (affinity.policy) {
+            case Affinity::Policy::None:
+                break;
+            case Affinity::Policy::CpuList:
+                for (unsigned cpu : affinity.cpus) {
+                    if (!online.empty() && std::ranges::find(online, cpu) == online.end()) {
+                        throw std::invalid_argument{
+                            "threaded_rng_cache::Affinity: CPU " + std::to_string(cpu) + " is not online."};
+                    }
+                }
+                assignInTurn(affinity.cpus);
+                break;
+            case Affinity::Policy::AvoidConsumerCore: {
+                if (!consumer) {
+                    break;
+                }
+                const std::vector<unsigned> consumerCore = coreSiblings(*consumer);
+                std::vector<unsigned> allowed;
+                std::ranges::copy_if(online, std::back_inserter(allowed), [&](unsigned cpu){
+                    return std::ranges::find(consumerCore, cpu) == consumerCore.end();
+                });
+                if (!allowed.empty()) {
+                    std::ranges::fill(sets, allowed);
+                }
+                break;
+            }
+            case Affinity::Policy::ConsumerSibling: {
+                if (!consumer) {
+                    break;
+                }
+                std::vector<unsigned> siblings = coreSiblings(*consumer);
+                std::erase(siblings, *consumer);
+                assignInTurn(siblings);
+                break;
+            }
+            case Affinity::Policy::OnePerPhysicalCore: {
+                const std::vector<unsigned> consumerCore = consumer ? coreSiblings(*consumer) : std::vector<unsigned>{};
+                std::vector<unsigned> cores;
+                for (unsigned cpu : online) {
+                    // The first sibling stands in for the whole core.
+                    const bool firstOfCore = coreSiblings(cpu).front() == cpu;
+                    if (firstOfCore && std::ranges::find(consumerCore, cpu) == consumerCore.end()) {
+                        cores.push_back(cpu);
+                    }
+                }
+                if (!consumerCore.empty()) {
+                    cores.push_back(consumerCore.front());
+                }
+                assignInTurn(cores);
+                break;
+            }
+            }
+            return sets;
+        }
+
+        // Restricts the calling thread to the given CPUs. Threads pin themselves before touching any memory, so
+        // that pages they fault in first are placed on the node they will run on. Placement is best effort; a
+        // thread the operating system refuses to move, for example because of a cgroup CPU restriction, keeps
+        // running where it was.
+        inline void
+        pin(const std::vector<unsigned>& cpus) {
+#if defined(__linux__)
+            if (cpus.empty()) {
+                return;
+            }
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (unsigned cpu : cpus) {
+                if (cpu < CPU_SETSIZE) {
+                    CPU_SET(cpu, &set);
+                }
+            }
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+            static_cast<void>(cpus);
+#endif
+        }
+        inline size_t
+        pageSize() {
+#if defined(__linux__)
+            static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            return size;
+#else
+            return 4096;
+#endif
+        }
+
+        inline size_t
+        roundToPages(size_t bytes) {
+            return (bytes + pageSize() - 1) / pageSize() * pageSize();
+        }
+
+        // Page aligned memory that is not touched until first written, so that its pages are placed
+        // according to the memory policy of the region or the thread first writing to them.
+        inline void*
+        allocatePages(size_t bytes) {
+#if defined(__linux__)
+            void* memory = mmap(
+                nullptr, roundToPages(bytes), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED) {
+                throw std::bad_alloc{};
+            }
+            return memory;
+#else
+            return ::operator new(roundToPages(bytes), std::align_val_t{pageSize()});
+#endif
+        }
+
+        inline void
+        deallocatePages(void* memory, size_t bytes) {
+#if defined(__linux__)
+            munmap(memory, roundToPages(bytes));
+#else
+            ::operator delete(memory, roundToPages(bytes), std::align_val_t{pageSize()});
+#endif
+        }
+
+        // Maps memory from the reserved huge page pool, returning nullptr if the pool cannot serve it.
+        // Deallocated with deallocatePages.
+        inline void*
+        allocateHugePages(size_t bytes) {
+#if defined(__linux__)
+            void* memory = mmap(
+                nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            return memory == MAP_FAILED ? nullptr : memory;
+#else
+            static_cast<void>(bytes);
+            return nullptr;
+#endif
+        }
+
+        inline std::vector<unsigned>
+        memoryNodes() {
+            const std::optional<std::string> nodes = readLine("/sys/devices/system/node/has_memory");
+            return nodes ? parseCpuList(*nodes) : std::vector<unsigned>{};
+        }
+
+        inline std::vector<unsigned>
+        nodeCpus(unsigned node) {
+            const std::optional<std::string> cpus =
+                readLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            return cpus ? parseCpuList(*cpus) : std::vector<unsigned>{};
+        }
+
+        inline std::optional<unsigned>
+        currentNode() {
+#if defined(__linux__)
+            unsigned cpu = 0;
+            unsigned node = 0;
+            if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) {
+                return node;
+            }
+#endif
+            return std::nullopt;
+        }
+
+        // A memory policy in the form taken by mbind(2), resolved once per cache from its Numa options.
+        struct NodeBinding {
+            // The kernel's MPOL_PREFERRED and MPOL_INTERLEAVE modes.
+            static constexpr int PREFERRED = 1;
+            static constexpr int INTERLEAVE = 3;
+
+            int mode = 0;
+            std::vector<unsigned long> nodeMask;
+
+            static NodeBinding
+            create(const Numa& numa) {
+                NodeBinding binding;
+                std::vector<unsigned> nodes;
+                if (numa.policy == Numa::Policy::ConsumerNode) {
+                    const std::optional<unsigned> node = currentNode();
+                    if (node) {
+                        binding.mode = PREFERRED;
+                        nodes = {*node};
+                    }
+                } else if (numa.policy == Numa::Policy::Interleave) {
+                    nodes = memoryNodes();
+                    if (nodes.size() > 1) {
+                        binding.mode = INTERLEAVE;
+                    }
+                }
+                if (binding.mode != 0) {
+                    constexpr size_t bitsPerWord = std::numeric_limits<unsigned long>::digits;
+                    binding.nodeMask.resize(*std::ranges::max_element(nodes) / bitsPerWord + 1);
+                    for (unsigned node : nodes) {
+                        binding.nodeMask[node / bitsPerWord] |= 1ul << (node % bitsPerWord);
+                    }
+                }
+                return binding;
+            }
+
+            // Applies the policy to the whole pages within memory that has not been touched yet. Best effort,
+            // like thread placement.
+            void
+            apply(void* memory, size_t bytes) const {
+#if defined(__linux__)
+                const uintptr_t address = reinterpret_cast<uintptr_t>(memory);
+                const uintptr_t begin = (address + pageSize() - 1) / pageSize() * pageSize();
+                const uintptr_t end = (address + bytes) / pageSize() * pageSize();
+                if (mode != 0 && begin < end) {
+                    const unsigned long maxNode = nodeMask.size() * std::numeric_limits<unsigned long>::digits;
+                    syscall(SYS_mbind, begin, end - begin, mode, nodeMask.data(), maxNode + 1, 0u);
+                }
+#else
+                static_cast<void>(memory);
+                static_cast<void>(bytes);
+#endif
+            }
+        };
+
+        // Writes to every page of the memory so that it is faulted in now rather than when first used, or locks it
+        // into RAM, which faults it in as well. Locking is best effort and limited by RLIMIT_MEMLOCK.
+        inline void
+        faultIn(void* memory, size_t bytes, bool lock) {
+#if defined(__linux__)
+            if (lock && mlock(memory, bytes) == 0) {
+                return;
+            }
+#else
+            static_cast<void>(lock);
+#endif
+            volatile char* const begin = static_cast<char*>(memory);
+            for (size_t offset = 0; offset < bytes; offset += pageSize()) {
+                begin[offset] = 0;
+            }
+        }
+
+        inline void
+        unlock(void* memory, size_t bytes) {
+#if defined(__linux__)
+            munlock(memory, bytes);
+#else
+            static_cast<void>(memory);
+            static_cast<void>(bytes);
+#endif
+        }
+
+        // The node each page of the memory resides on, or -1 for pages the kernel could not tell.
+        inline std::vector<int>
+        pageNodes(const void* memory, size_t bytes) {
+            const size_t pageCount = roundToPages(bytes) / pageSize();
+            std::vector<int> nodes(pageCount, -1);
+#if defined(__linux__)
+            std::vector<const void*> pages(pageCount);
+            for (size_t i = 0; i < pageCount; ++i) {
+                pages[i] = static_cast<const char*>(memory) + i * pageSize();
+            }
+            if (syscall(SYS_move_pages, 0, pageCount, pages.data(), nullptr, nodes.data(), 0) != 0) {
+                std::ranges::fill(nodes, -1);
+            }
+            std::ranges::replace_if(nodes, [](int node){ return node < 0; }, -1);
+#else
+            static_cast<void>(memory);
+#endif
+            return nodes;
+        }
+        // Deletes objects created by allocateUnique. Refers to the allocator instead of holding a copy, so the
+        // allocator has to outlive all objects created from it.
+        template<typename AllocatorT>
+        class AllocatorDeleter {
+        public:
+            AllocatorDeleter() = default;
+
+            explicit AllocatorDeleter(const AllocatorT& allocator)
+            : m_allocator(&allocator)
+            {}
+
+            template<typename T>
+            void
+            operator()(T* object) const {
+                using Traits = std::allocator_traits<AllocatorT>::template rebind_traits<T>;
+                typename Traits::allocator_type allocator{*m_allocator};
+                Traits::destroy(allocator, object);
+                Traits::deallocate(allocator, object, 1);
+            }
+
+        private:
+            const AllocatorT* m_allocator = nullptr;
+        };
+
+        template<typename T, typename AllocatorT, typename... ArgsT>
+        std::unique_ptr<T, AllocatorDeleter<AllocatorT>>
+        allocateUnique(const AllocatorT& allocator, ArgsT&&... args) {
+            using Traits = std::allocator_traits<AllocatorT>::template rebind_traits<T>;
+            typename Traits::allocator_type rebound{allocator};
+            T* object = Traits::allocate(rebound, 1);
+            try {
+                Traits::construct(rebound, object, std::forward<ArgsT>(args)...);
+            } catch (...) {
+                Traits::deallocate(rebound, object, 1);
+                throw;
+            }
+            return std::unique_ptr<T, AllocatorDeleter<AllocatorT>>{object, AllocatorDeleter<AllocatorT>{allocator}};
+        }
+
+        // Allocates the storage of a cache's chunks from its allocator according to its huge page and NUMA
+        // options. Without huge pages every chunk is allocated on its own. With huge pages chunks are carved out
+        // of larger blocks, which are kept until the cache is destroyed and hand out the chunks of destroyed
+        // handles again.
+        template<typename AllocatorT>
+        class ChunkMemory {
+            using Traits = std::allocator_traits<AllocatorT>;
+            using value_type = Traits::value_type;
+
+            static_assert(std::is_same_v<typename Traits::pointer, value_type*>,
+                          "threaded_rng_cache::RngCache: Allocators with fancy pointers are not supported.");
+
+        public:
+            static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+            ChunkMemory(
+                size_t chunkSize,
+                HugePages hugePages,
+                const Numa& numa,
+                bool prefault,
+                bool lockMemory,
+                const AllocatorT& allocator)
+            : m_allocator(allocator)
+            , m_chunkSize(chunkSize)
+            , m_chunkStride(roundToPages(chunkSize * sizeof(value_type)))
+            , m_blockBytes((m_chunkStride + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE)
+            , m_hugePages(hugePages)
+            , m_prefault(prefault || lockMemory)
+            , m_lockMemory(lockMemory)
+            , m_binding(NodeBinding::create(numa))
+            , m_mutex()
+            , m_blocks()
+            , m_free()
+            {}
+
+            ChunkMemory(const ChunkMemory&) = delete;
+            ChunkMemory& operator=(const ChunkMemory&) = delete;
+
+            ~ChunkMemory() {
+                for (const Block& block : m_blocks) {
+                    if (m_lockMemory) {
+                        unlock(block.memory, block.size * sizeof(value_type));
+                    }
+                    Traits::deallocate(m_allocator, block.memory, block.size);
+                }
+            }
+
+            // Returns storage for one chunk. Safe to call from any thread.
+            value_type*
+            allocate() {
+                if (m_hugePages == HugePages::None) {
+                    value_type* memory = Traits::allocate(m_allocator, m_chunkSize);
+                    m_binding.apply(memory, m_chunkSize * sizeof(value_type));
+                    if (m_prefault) {
+                        faultIn(memory, m_chunkSize * sizeof(value_type), m_lockMemory);
+                    }
+                    return memory;
+                }
+                std::lock_guard lock{m_mutex};
+                if (m_free.empty()) {
+                    addBlock();
+                }
+                value_type* memory = m_free.back();
+                m_free.pop_back();
+                return memory;
+            }
+
+            void
+            deallocate(value_type* memory) {
+                if (m_hugePages == HugePages::None) {
+                    if (m_lockMemory) {
+                        unlock(memory, m_chunkSize * sizeof(value_type));
+                    }
+                    Traits::deallocate(m_allocator, memory, m_chunkSize);
+                    return;
+                }
+                std::lock_guard lock{m_mutex};
+                m_free.push_back(memory);
+            }
+
+            const AllocatorT&
+            allocator() const {
+                return m_allocator;
+            }
+
+            size_t
+            chunkSize() const {
+                return m_chunkSize;
+            }
+
+            const NodeBinding&
+            binding() const {
+                return m_binding;
+            }
+
+        private:
+            struct Block {
+                value_type* memory;
+                size_t size;
+            };
+
+            void
+            addBlock() {
+                const Block block = allocateBlock();
+                m_blocks.push_back(block);
+                // Start at the first huge page boundary, which transparent huge pages need.
+                const uintptr_t address = reinterpret_cast<uintptr_t>(block.memory);
+                char* begin = reinterpret_cast<char*>(block.memory)
+                    + (HUGE_PAGE_SIZE - address % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+#if defined(__linux__)
+                madvise(begin, m_blockBytes, MADV_HUGEPAGE);
+#endif
+                m_binding.apply(begin, m_blockBytes);
+                if (m_prefault) {
+                    faultIn(begin, m_blockBytes, m_lockMemory);
+                }
+                for (size_t offset = 0; offset + m_chunkStride <= m_blockBytes; offset += m_chunkStride) {
+                    m_free.push_back(reinterpret_cast<value_type*>(begin + offset));
+                }
+            }
+
+            Block
+            allocateBlock() {
+                if constexpr (requires(AllocatorT& allocator, size_t size) { allocator.allocate_huge(size); }) {
+                    // Huge page mappings can only be unmapped in whole huge pages.
+                    if (m_hugePages == HugePages::Explicit && m_blockBytes % sizeof(value_type) == 0) {
+                        const size_t size = m_blockBytes / sizeof(value_type);
+                        value_type* memory = m_allocator.allocate_huge(size);
+                        if (memory != nullptr) {
+                            return {memory, size};
+                        }
+                    }
+                }
+                // Over-allocate so that the block can be aligned to a huge page boundary. The slack is never
+                // touched and so costs no memory.
+                const size_t size = (m_blockBytes + HUGE_PAGE_SIZE + sizeof(value_type) - 1) / sizeof(value_type);
+                return {Traits::allocate(m_allocator, size), size};
+            }
+
+            AllocatorT m_allocator;
+            size_t m_chunkSize;
+            size_t m_chunkStride;
+            size_t m_blockBytes;
+            HugePages m_hugePages;
+            bool m_prefault;
+            bool m_lockMemory;
+            NodeBinding m_binding;
+            std::mutex m_mutex;
+            std::vector<Block> m_blocks;
+            std::vector<value_type*> m_free;
+        };
+    } // namespace detail
+
+    // The default allocator of the caches. Allocations of at least a page are mapped as whole pages that are not
+    // touched until first written, so that the chunks are placed by the NUMA options or by the producers filling
+    // them. Smaller allocations come from the heap. Also provides allocate_huge for HugePages::Explicit.
+    template<typename T>
+    class PageAllocator {
+    public:
+        using value_type = T;
+
+        PageAllocator() = default;
+
+        template<typename U>
+        PageAllocator(const PageAllocator<U>&) noexcept
+        {}
+
+        T*
+        allocate(size_t count) {
+            const size_t bytes = count * sizeof(T);
+            if (bytes < detail::pageSize()) {
+                return static_cast<T*>(::operator new(bytes, std::align_val_t{alignof(T)}));
+            }
+            return static_cast<T*>(detail::allocatePages(bytes));
+        }
+
+        void
+        deallocate(T* memory, size_t count) noexcept {
+            const size_t bytes = count * sizeof(T);
+            if (bytes < detail::pageSize()) {
+                ::operator delete(memory, bytes, std::align_val_t{alignof(T)});
+            } else {
+                detail::deallocatePages(memory, bytes);
+            }
+        }
+
+        // Maps count objects from the reserved huge page pool, or returns nullptr if the pool cannot serve them.
+        // The size must be a multiple of the huge page size. Deallocated with deallocate like any other allocation.
+        T*
+        allocate_huge(size_t count) {
+            return static_cast<T*>(detail::allocateHugePages(count * sizeof(T)));
+        }
+
+        template<typename U>
+        bool
+        operator==(const PageAllocator<U>&) const noexcept {
+            return true;
+        }
+    };
+
+    // Distributions can opt in to producing a whole block of values per call, which the producers then use
+    // instead of calling the distribution once per value.
+    template<typename DistributionT, typename EngineT>
+    concept BatchDistribution = requires(DistributionT& distribution,
+                                         std::span<typename DistributionT::result_type> values,
+                                         EngineT& engine) {
+        distribution.generate(values, engine);
+    };
+
+    // Engines can likewise opt in to producing a block of values per call, which the producers then draw from
+    // through a buffer for distributions without a batch path of their own.
+    template<typename EngineT>
+    concept BatchEngine = requires(EngineT& engine, std::span<typename EngineT::result_type> values) {
+        engine.generate(values);
+    };
+
+    namespace detail
+    {
+        // Presents a batch engine to a distribution one value at a time while refilling from it a buffer at a
+        // time. Values left in the buffer when it goes out of scope are skipped.
+        template<BatchEngine EngineT>
+        class BufferedEngine {
+        public:
+            using result_type = EngineT::result_type;
+
+            explicit BufferedEngine(EngineT& engine)
+            : m_engine(&engine)
+            , m_next(BUFFER_SIZE)
+            , m_buffer()
+            {}
+
+            static constexpr result_type
+            min() {
+                return EngineT::min();
+            }
+
+            static constexpr result_type
+            max() {
+                return EngineT::max();
+            }
+
+            result_type
+            operator()() {
+                if (m_next == BUFFER_SIZE) {
+                    m_engine->generate(m_buffer);
+                    m_next = 0;
+                }
+                return m_buffer[m_next++];
+            }
+
+        private:
+            static constexpr size_t BUFFER_SIZE = 256;
+
+            EngineT* m_engine;
+            size_t m_next;
+            std::array<result_type, BUFFER_SIZE> m_buffer;
+        };
+    } // namespace detail
+
+    // Engines that can move to the start of any of 2^64 independent streams in constant time, such as the
+    // counter-based engines of threaded_rng_cache_engines.hpp. Sequenced producers then position the engine for
+    // each block by its stream instead of reseeding it.
+    template<typename EngineT>
+    concept StreamEngine = requires(EngineT& engine, uint64_t stream) {
+        engine.set_stream(stream);
+    };
+
+    // How a consumer waits for a chunk that is still being filled. A policy provides a static wait that returns
+    // the first value of the atomic for which done returns true. Producers waiting for a free slot always block.
+
+    // Sleeps on the atomic until the producer notifies it. Costs a futex wake-up per stall but no CPU time.
+    struct BlockingWait {
+        template<typename T, std::predicate<T> DoneT>
+        static T
+        wait(const std::atomic<T>& atomic, DoneT&& done) {
+            T value = atomic.load(std::memory_order_acquire);
+            while (!done(value)) {
+                atomic.wait(value, std::memory_order_acquire);
+                value = atomic.load(std::memory_order_acquire);
+            }
+            return value;
+        }
+    };
+
+    // Polls the atomic until done, for consumers that own a core and cannot afford to be woken up.
+    struct SpinWait {
+        template<typename T, std::predicate<T> DoneT>
+        static T
+        wait(const std::atomic<T>& atomic, DoneT&& done) {
+            T value = atomic.load(std::memory_order_acquire);
+            while (!done(value)) {
+                detail::pause();
+                value = atomic.load(std::memory_order_acquire);
+            }
+            return value;
+        }
+    };
+
+    // Polls the atomic SPINS times, then yields the CPU YIELDS times and then blocks, so that short stalls
+    // are served without sleeping while long ones do not burn a core.
+    template<size_t SPINS = 4096, size_t YIELDS = 16>
+    struct HybridWait {
+        template<typename T, std::predicate<T> DoneT>
+        static T
+        wait(const std::atomic<T>& atomic, DoneT&& done) {
+            T value = atomic.load(std::memory_order_acquire);
+            for (size_t i = 0; i < SPINS && !done(value); ++i) {
+                detail::pause();
+                value = atomic.load(std::memory_order_acquire);
+            }
+            for (size_t i = 0; i < YIELDS && !done(value); ++i) {
+                std::this_thread::yield();
+                value = atomic.load(std::memory_order_acquire);
+            }
+            if (done(value)) {
+                return value;
+            }
+            return BlockingWait::wait(atomic, std::forward<DoneT>(done));
+        }
+    };
+
+    // Makes operator(), fill and generate_n wait-free: when the next chunk is not ready they take the values from
+    // a fallback engine of the consumer's own rather than waiting, leaving the chunk to be picked up by a later call.
+    // The fallback values are not part of the deterministic sequence. acquire, remaining_span and the warm-up calls,
+    // which cannot do without a chunk, still block, as do lazily started producers on their first use. On a
+    // ProducerPool each swap and each first miss still wakes a worker with a futex notify and may adapt the pool's
+    // active thread count, which only ever tries its lock. Numa::statistics, which allocates and makes system calls
+    // on every swap, is not recorded for these consumers.
+    struct NonBlockingWait : BlockingWait {};
+
+    // A set of worker threads filling chunks for any number of caches. Caches given a pool through
+    // Options::pool start no threads of their own; the workers instead keep picking whichever registered
+    // job is closest to running dry.
+    class ProducerPool {
+    public:
+        // Something the workers can fill chunks for, in practice the producers of one cache.
+        class Job {
+        public:
+            virtual ~Job() = default;
+
+            // Fraction of the job's chunks that are filled and waiting for a consumer, 0 meaning it has run dry.
+            virtual double
+            fillLevel() const = 0;
+
+            // Fills one chunk if there is one free that no other worker is filling. Returns whether it did.
+            virtual bool
+            produce() = 0;
+
+        private:
+            friend class ProducerPool;
+
+            std::atomic<size_t> m_workers{0};
+        };
+
+        explicit ProducerPool(
+            size_t threadCount = std::max(std::thread::hardware_concurrency(), 1u),
+            const Affinity& affinity = {})
+        : ProducerPool(threadCount, threadCount, affinity)
+        {}
+
+        // An adaptive pool starting with minThreadCount active workers. Every ADAPT_WINDOW swaps it wakes one more
+        // of its parked workers if the consumers stalled on more than one in STALL_TOLERANCE of them, or parks one
+        // if there were no stalls and its active workers spent more than half of the time idle.
+        ProducerPool(size_t minThreadCount, size_t maxThreadCount, const Affinity& affinity)
+        : m_mutex()
+        , m_jobs()
+        , m_shutdown(false)
+        , m_epoch(0)
+        , m_minThreadCount(minThreadCount)
+        , m_activeThreadCount(minThreadCount)
+        , m_swaps(0)
+        , m_stalls(0)
+        , m_idleNanoseconds(0)
+        , m_adaptMutex()
+        , m_windowBegin(std::chrono::steady_clock::now())
+        , m_threads()
+        {
+            if (minThreadCount == 0) {
+                throw std::invalid_argument{"threaded_rng_cache::ProducerPool: Thread count must be at least one."};
+            }
+            if (minThreadCount > maxThreadCount) {
+                throw std::invalid_argument{
+                    "threaded_rng_cache::ProducerPool: Minimum thread count exceeds maximum thread count."};
+            }
+            const std::vector<std::vector<unsigned>> placement = detail::placement(affinity, maxThreadCount);
+            for (size_t i = 0; i < maxThreadCount; ++i) {
+                m_threads.emplace_back([this, i, cpus = placement[i]](){ run(i, cpus); });
+            }
+        }
+
+        ProducerPool(const ProducerPool&) = delete;
+        ProducerPool& operator=(const ProducerPool&) = delete;
+
+        ~ProducerPool() {
+            m_shutdown.store(true);
+            m_epoch.fetch_add(1, std::memory_order_release);
+            m_epoch.notify_all();
+            // Unpark all workers so that they see the shutdown.
+            m_activeThreadCount.store(m_threads.size() + 1, std::memory_order_release);
+            m_activeThreadCount.notify_all();
+            for (std::thread& thread : m_threads) {
+                thread.join();
+            }
+        }
+
+        // A process-wide pool with one worker per hardware thread, created on first use.
+        static std::shared_ptr<ProducerPool>
+        global() {
+            static const std::shared_ptr<ProducerPool> pool = std::make_shared<ProducerPool>();
+            return pool;
+        }
+
+        size_t
+        threadCount() const {
+            return m_threads.size();
+        }
+
+        // Workers not currently parked. Only differs from threadCount for adaptive pools.
+        size_t
+        activeThreadCount() const {
+            return std::min(m_activeThreadCount.load(std::memory_order_relaxed), m_threads.size());
+        }
+
+        void
+        attach(Job& job) {
+            {
+                std::lock_guard lock{m_mutex};
+                m_jobs.push_back(&job);
+            }
+            m_epoch.fetch_add(1, std::memory_order_release);
+            m_epoch.notify_all();
+        }
+
+        // Removes the job and waits for any worker still filling a chunk for it.
+        void
+        detach(Job& job) {
+            {
+                std::lock_guard lock{m_mutex};
+                std::erase(m_jobs, &job);
+            }
+            size_t workers = job.m_workers.load(std::memory_order_acquire);
+            while (workers != 0) {
+                job.m_workers.wait(workers, std::memory_order_acquire);
+                workers = job.m_workers.load(std::memory_order_acquire);
+            }
+        }
+
+        // Tells the workers that a job may have new work, typically because a consumer released a slot.
+        void
+        wake() {
+            m_epoch.fetch_add(1, std::memory_order_release);
+            m_epoch.notify_one();
+        }
+
+        // Counts a consumer's swap for adapting the number of active workers.
+        void
+        recordSwap(bool stalled) {
+            if (m_minThreadCount == m_threads.size()) {
+                return;
+            }
+            if (stalled) {
+                m_stalls.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (m_swaps.fetch_add(1, std::memory_order_relaxed) % ADAPT_WINDOW == ADAPT_WINDOW - 1) {
+                adapt();
+            }
+        }
+
+        static constexpr size_t ADAPT_WINDOW = 64;
+        static constexpr size_t STALL_TOLERANCE = 32;
+
+    private:
+        void
+        run(size_t index, const std::vector<unsigned>& cpus) {
+            detail::pin(cpus);
+            std::vector<std::pair<double, Job*>> candidates;
+            while (!m_shutdown.load()) {
+                const size_t active = m_activeThreadCount.load(std::memory_order_acquire);
+                if (index >= active) {
+                    m_activeThreadCount.wait(active, std::memory_order_acquire);
+                    continue;
+                }
+                const uint32_t epoch = m_epoch.load(std::memory_order_acquire);
+                if (!produceOnce(candidates)) {
+                    const auto begin = std::chrono::steady_clock::now();
+                    m_epoch.wait(epoch, std::memory_order_acquire);
+                    const std::chrono::nanoseconds idle = std::chrono::steady_clock::now() - begin;
+                    m_idleNanoseconds.fetch_add(static_cast<uint64_t>(idle.count()), std::memory_order_relaxed);
+                }
+            }
+        }
+
+        void
+        adapt() {
+            std::unique_lock lock{m_adaptMutex, std::try_to_lock};
+            if (!lock) {
+                return;
+            }
+            const auto now = std::chrono::steady_clock::now();
+            const std::chrono::duration<double, std::nano> window = now - m_windowBegin;
+            m_windowBegin = now;
+            const uint64_t stalls = m_stalls.exchange(0, std::memory_order_relaxed);
+            const double idle = static_cast<double>(m_idleNanoseconds.exchange(0, std::memory_order_relaxed));
+
+            const size_t active = m_activeThreadCount.load(std::memory_order_relaxed);
+            if (stalls * STALL_TOLERANCE > ADAPT_WINDOW && active < m_threads.size()) {
+                m_activeThreadCount.store(active + 1, std::memory_order_release);
+                m_activeThreadCount.notify_all();
+            } else if (stalls == 0 && idle > 0.5 * window.count() * static_cast<double>(active)
+                       && active > m_minThreadCount) {
+                // The parked worker notices on its next wake up.
+                m_activeThreadCount.store(active - 1, std::memory_order_release);
+            }
+        }
+
+        // Tries the jobs from the driest to the fullest until one of them fills a chunk.
+        bool
+        produceOnce(std::vector<std::pair<double, Job*>>& candidates) {
+            candidates.clear();
+            {
+                std::lock_guard lock{m_mutex};
+                for (Job* job : m_jobs) {
+                    job->m_workers.fetch_add(1, std::memory_order_relaxed);
+                    candidates.emplace_back(job->fillLevel(), job);
+                }
+            }
+            std::ranges::sort(candidates, {}, &std::pair<double, Job*>::first);
+
+            bool produced = false;
+            for (auto& [fillLevel, job] : candidates) {
+                produced = produced || job->produce();
+                job->m_workers.fetch_sub(1, std::memory_order_release);
+                job->m_workers.notify_all();
+            }
+            return produced;
+        }
+
+        std::mutex m_mutex;
+        std::vector<Job*> m_jobs;
+        std::atomic<bool> m_shutdown;
+        alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> m_epoch;
+        size_t m_minThreadCount;
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_activeThreadCount;
+        std::atomic<uint64_t> m_swaps;
+        std::atomic<uint64_t> m_stalls;
+        std::atomic<uint64_t> m_idleNanoseconds;
+        std::mutex m_adaptMutex;
+        std::chrono::steady_clock::time_point m_windowBegin;
+        std::vector<std::thread> m_threads;
+    };
+
+    struct Options {
+        // Number of filled chunks each producer may keep ready ahead of the consumer.
+        size_t queueDepth = 1;
+        // Worker threads to fill the chunks on instead of one thread per producer, for example
+        // ProducerPool::global(). The thread count passed to the cache then only sets the number of producers.
+        std::shared_ptr<ProducerPool> pool;
+        // Placement of the producer threads. A pool places its own workers when it is constructed.
+        Affinity affinity;
+        // Placement of the chunk memory.
+        Numa numa;
+        HugePages hugePages = HugePages::None;
+        // Fault in all chunk memory and fill every producer's chunks before the constructor returns, so that
+        // the consumer takes no page faults and finds its first chunks ready. The pages are touched by the
+        // constructing thread, which places them on its node unless a Numa policy says otherwise.
+        bool prefault = false;
+        // Lock the chunk memory into RAM with mlock, which implies prefault. Best effort, as the amount of locked
+        // memory is limited by RLIMIT_MEMLOCK.
+        bool lockMemory = false;
+        // Run the producers on a private adaptive pool, see ProducerPool, which keeps between minThreads and the
+        // thread count passed to the cache active. An adaptive pool of one's own can also be given as pool.
+        bool adaptiveThreads = false;
+        size_t minThreads = 1;
+        // Number of values per chunk for caches with CHUNK_SIZE = std::dynamic_extent, 0 choosing it from the
+        // size of the L2 cache. Must be left at 0 for caches with a fixed chunk size.
+        size_t chunkSize = 0;
+        // Order in which the consumers take the producers' chunks.
+        Ordering ordering = Ordering::RoundRobin;
+        // Have the constructor call RngCache::prefill, returning with a full active chunk and full producers.
+        bool prefill = false;
+        // Allocate each producer's chunks and start its thread only once the consumers are about to ask it for
+        // a chunk, which makes short-lived caches cheap to construct. The output is the same either way.
+        bool lazyStart = false;
+    };
+
+    struct Statistics {
+        // Chunks taken from the producers.
+        size_t swaps = 0;
+        // Swaps where the producer had not yet finished the chunk and the consumer had to wait for it.
+        size_t stalls = 0;
+        // Pages of the received chunks by the NUMA node they reside on. Only gathered with Numa::statistics.
+        std::vector<size_t> pagesByNode;
+        // Pages of the received chunks residing on another node than the one the consumer was running on.
+        size_t remotePages = 0;
+        // Values served by the fallback engine of NonBlockingWait consumers because no chunk was ready, plus
+        // try_generate, generate_until and generate_for calls that came back empty.
+        size_t fallbacks = 0;
+    };
+
     template<typename DistributionT,
              typename EngineT = std::mt19937_64,
-             size_t CHUNK_SIZE = /* 128 KiB */ 128 * 1024 / sizeof(typename DistributionT::result_type)>
+             // Values per chunk, or std::dynamic_extent to choose it at runtime through Options::chunkSize.
+             size_t CHUNK_SIZE = /* 128 KiB */ 128 * 1024 / sizeof(typename DistributionT::result_type),
+             typename AllocatorT = PageAllocator<typename DistributionT::result_type>,
+             // How consumers wait for chunks still being filled: BlockingWait, SpinWait, HybridWait or NonBlockingWait.
+             typename WaitPolicyT = BlockingWait>
     class RngCache {
+        class Chunk;
+        class Producer;
+        class Pipeline;
+
+        template<typename T>
+        using Allocator = std::allocator_traits<AllocatorT>::template rebind_alloc<T>;
+        using ChunkMemory = detail::ChunkMemory<Allocator<typename DistributionT::result_type>>;
+        using Deleter = detail::AllocatorDeleter<Allocator<typename DistributionT::result_type>>;
+
     public:
         using result_type = DistributionT::result_type;
         using seed_type = EngineT::result_type;
 
+        // A consumer of the cache with its own active chunk. Handles can be used concurrently from different
+        // threads while all of them draw chunks from the same producers; each handle must only be used by one
+        // thread at a time and must not outlive the cache it was created from. Which handle receives which chunk
+        // depends on timing, so the values seen by a single handle are not deterministic.
+        class Handle {
+        public:
+            result_type
+            operator()() {
+                return generate();
+            }
+
+            // Returns the next value if it can be had without waiting for a producer.
+            std::optional<result_type>
+            try_generate() {
+                if (m_activeChunk->empty() && !trySwapChunk()) {
+                    ++m_statistics.fallbacks;
+                    return std::nullopt;
+                }
+                return m_activeChunk->next();
+            }
+
+            // Returns the next value, or nothing if the next chunk is not ready by the deadline.
+            template<typename ClockT, typename DurationT>
+            std::optional<result_type>
+            generate_until(const std::chrono::time_point<ClockT, DurationT>& deadline) {
+                if (m_activeChunk->empty() && !detail::pollUntil(deadline, [this](){ return trySwapChunk(); })) {
+                    ++m_statistics.fallbacks;
+                    return std::nullopt;
+                }
+                return m_activeChunk->next();
+            }
+
+            // Returns the next value, or nothing if the next chunk is not ready within the timeout.
+            template<typename RepT, typename PeriodT>
+            std::optional<result_type>
+            generate_for(const std::chrono::duration<RepT, PeriodT>& timeout) {
+                // Only look at the clock when there is a chunk to wait for.
+                if (!m_activeChunk->empty()) {
+                    return m_activeChunk->next();
+                }
+                return generate_until(std::chrono::steady_clock::now() + timeout);
+            }
+
+            // Fills the whole output range, copying from the cached chunks in bulk.
+            void
+            fill(std::span<result_type> output) {
+                generate_n(output.begin(), output.size());
+            }
+
+            // Writes the next count values to output and returns the iterator past the last written value.
+            // Non-blocking handles fall back for at most a chunk's worth of values at a time before looking for
+            // a ready chunk again, so that a large request does not bypass the cache altogether.
+            template<std::output_iterator<result_type> OutputIt>
+            OutputIt
+            generate_n(OutputIt output, size_t count) {
+                while (count > 0) {
+                    if constexpr (NON_BLOCKING) {
+                        if (m_activeChunk->empty() && !trySwapChunk()) {
+                            const size_t fallbacks = std::min(count, m_pipeline->memory().chunkSize());
+                            m_statistics.fallbacks += fallbacks;
+                            output = std::ranges::generate_n(std::move(output), fallbacks, [this](){
+                                return m_fallback.distribution(m_fallback.engine);
+                            });
+                            count -= fallbacks;
+                            continue;
+                        }
+                    } else {
+                        ensureActiveChunk();
+                    }
+                    const std::span<const result_type> values = m_activeChunk->take(count);
+                    output = std::ranges::copy(values, output).out;
+                    count -= values.size();
+                }
+                return output;
+            }
+
+            // Borrows up to count values straight out of the active chunk without copying them.
+            // The returned span is never empty and stays valid until the next call on this handle.
+            // Throws std::invalid_argument if count is 0.
+            std::span<const result_type>
+            acquire(size_t count) {
+                if (count == 0) {
+                    throw std::invalid_argument{"threaded_rng_cache::RngCache: Cannot acquire zero values."};
+                }
+                ensureActiveChunk();
+                return m_activeChunk->take(count);
+            }
+
+            // Borrows all values left in the active chunk, refilling it first if it has run out.
+            std::span<const result_type>
+            remaining_span() {
+                ensureActiveChunk();
+                return m_activeChunk->take(m_activeChunk->remaining());
+            }
+
+            // Blocks until every producer has filled all the chunks it may keep ready ahead of the consumers.
+            void
+            wait_until_ready() {
+                m_pipeline->waitUntilReady();
+            }
+
+            // Loads a full active chunk if the current one has run out and then waits until the producers are
+            // ready, so that the following values are served without waiting.
+            void
+            prefill() {
+                ensureActiveChunk();
+                wait_until_ready();
+            }
+
+            const Statistics&
+            statistics() const {
+                return m_statistics;
+            }
+
+        private:
+            friend class RngCache;
+
+            static constexpr bool NON_BLOCKING = std::is_same_v<WaitPolicyT, NonBlockingWait>;
+
+            struct Fallback {
+                DistributionT distribution;
+                EngineT engine;
+            };
+
+            struct NoFallback {};
+
+            explicit Handle(Pipeline& pipeline)
+            : m_pipeline(&pipeline)
+            , m_activeChunk(detail::allocateUnique<Chunk>(pipeline.memory().allocator(), pipeline.memory()))
+            , m_statistics()
+            , m_missed(false)
+            , m_fallback(createFallback(pipeline))
+            {}
+
+            static std::conditional_t<NON_BLOCKING, Fallback, NoFallback>
+            createFallback(Pipeline& pipeline) {
+                if constexpr (NON_BLOCKING) {
+                    return Fallback{pipeline.distribution(), EngineT{pipeline.fallbackSeed()}};
+                } else {
+                    return NoFallback{};
+                }
+            }
+
+            void
+            ensureActiveChunk() {
+                if (m_activeChunk->empty()) {
+                    if (m_pipeline->swapChunk(m_activeChunk)) {
+                        ++m_statistics.stalls;
+                    }
+                    swapped();
+                }
+            }
+
+            // Reports the first miss of each run of misses to the pipeline, so that a consumer falling back or
+            // giving up is counted as a single stall however often it retries.
+            bool
+            trySwapChunk() {
+                if (!m_pipeline->trySwapChunk(m_activeChunk)) {
+                    if (!m_missed) {
+                        m_pipeline->missed();
+                        m_missed = true;
+                    }
+                    return false;
+                }
+                m_missed = false;
+                swapped();
+                return true;
+            }
+
+            void
+            swapped() {
+                ++m_statistics.swaps;
+                if (!NON_BLOCKING && m_pipeline->numaStatistics()) {
+                    recordPageNodes();
+                }
+            }
+
+            void
+            recordPageNodes() {
+                const std::optional<unsigned> consumerNode = detail::currentNode();
+                for (int node : m_activeChunk->pageNodes()) {
+                    if (node < 0) {
+                        continue;
+                    }
+                    const size_t index = static_cast<size_t>(node);
+                    if (index >= m_statistics.pagesByNode.size()) {
+                        m_statistics.pagesByNode.resize(index + 1);
+                    }
+                    ++m_statistics.pagesByNode[index];
+                    if (consumerNode && index != *consumerNode) {
+                        ++m_statistics.remotePages;
+                    }
+                }
+            }
+
+            result_type
+            generate() {
+                if constexpr (NON_BLOCKING) {
+                    if (const std::optional<result_type> value = try_generate()) {
+                        return *value;
+                    }
+                    return m_fallback.distribution(m_fallback.engine);
+                } else {
+                    ensureActiveChunk();
+                    return m_activeChunk->next();
+                }
+            }
+
+            Pipeline* m_pipeline;
+            Chunk::pointer m_activeChunk;
+            Statistics m_statistics;
+            bool m_missed;
+            [[no_unique_address]] std::conditional_t<NON_BLOCKING, Fallback, NoFallback> m_fallback;
+        };
+
+        // The chunks and producers are allocated with the given allocator, rebound as needed. The huge page and
+        // NUMA options are applied on top of the memory it returns, which works best with page aligned memory
+        // that has not been touched yet, as PageAllocator returns.
         RngCache(
             const DistributionT& distribution,
             std::optional<seed_type> seed = {},
-            std::optional<size_t> threadCount = {})
+            std::optional<size_t> threadCount = {},
+            const Options& options = {},
+            const AllocatorT& allocator = {})
         : RngCache(
             distribution,
             seed ? *seed : randomSeed(),
-            threadCount ? *threadCount : std::thread::hardware_concurrency())
+            threadCount ? *threadCount : std::max(std::thread::hardware_concurrency(), 1u),
+            options,
+            allocator)
         {}
 
         result_type
         operator()() {
-            return generate();
+            return m_consumer();
+        }
+
+        // Returns the next value if it can be had without waiting for a producer.
+        std::optional<result_type>
+        try_generate() {
+            return m_consumer.try_generate();
+        }
+
+        // Returns the next value, or nothing if the next chunk is not ready by the deadline.
+        template<typename ClockT, typename DurationT>
+        std::optional<result_type>
+        generate_until(const std::chrono::time_point<ClockT, DurationT>& deadline) {
+            return m_consumer.generate_until(deadline);
+        }
+
+        // Returns the next value, or nothing if the next chunk is not ready within the timeout.
+        template<typename RepT, typename PeriodT>
+        std::optional<result_type>
+        generate_for(const std::chrono::duration<RepT, PeriodT>& timeout) {
+            return m_consumer.generate_for(timeout);
+        }
+
+        // Fills the whole output range, copying from the cached chunks in bulk.
+        void
+        fill(std::span<result_type> output) {
+            m_consumer.fill(output);
+        }
+
+        // Writes the next count values to output and returns the iterator past the last written value.
+        template<std::output_iterator<result_type> OutputIt>
+        OutputIt
+        generate_n(OutputIt output, size_t count) {
+            return m_consumer.generate_n(std::move(output), count);
+        }
+
+        // Borrows up to count values straight out of the active chunk without copying them.
+        // The returned span is never empty and stays valid until the next call on this cache.
+        // Throws std::invalid_argument if count is 0.
+        std::span<const result_type>
+        acquire(size_t count) {
+            return m_consumer.acquire(count);
+        }
+
+        // Borrows all values left in the active chunk, refilling it first if it has run out.
+        std::span<const result_type>
+        remaining_span() {
+            return m_consumer.remaining_span();
+        }
+
+        // Blocks until every producer has filled all the chunks it may keep ready ahead of the consumers.
+        void
+        wait_until_ready() {
+            m_consumer.wait_until_ready();
+        }
+
+        // Loads a full active chunk if the current one has run out and then waits until the producers are
+        // ready, so that the following values are served without waiting.
+        void
+        prefill() {
+            m_consumer.prefill();
+        }
+
+        const Statistics&
+        statistics() const {
+            return m_consumer.statistics();
+        }
+
+        // Number of values per chunk, as given by CHUNK_SIZE or chosen at runtime.
+        size_t
+        chunk_size() const {
+            return m_pipeline->memory().chunkSize();
+        }
+
+        // Creates an additional consumer drawing from the same producers, for use on another thread.
+        Handle
+        handle() {
+            return Handle{*m_pipeline};
         }
 
     private:
         RngCache(
             const DistributionT& distribution,
             seed_type seed,
-            size_t threadCount)
-        : m_activeChunk(std::make_unique<Chunk>())
-        , m_producers(Producer::create(distribution, seed, threadCount))
-        , m_nextProducer(m_producers.begin())
-        {}
+            size_t threadCount,
+            const Options& options,
+            const AllocatorT& allocator)
+        : m_pipeline(std::make_unique<Pipeline>(
+            distribution,
+            seed,
+            threadCount,
+            withAdaptivePool(threadCount, validate(threadCount, options)),
+            allocator))
+        , m_consumer(*m_pipeline)
+        {
+            if (options.prefill) {
+                m_consumer.prefill();
+            }
+        }
 
         class Chunk {
         public:
-            using pointer = std::unique_ptr<Chunk>;
+            using pointer = std::unique_ptr<Chunk, Deleter>;
 
-            Chunk()
-            : m_nextIndex(CHUNK_SIZE)
-            , m_values()
+            explicit Chunk(ChunkMemory& memory)
+            : m_size(memory.chunkSize())
+            , m_nextIndex(size())
+            , m_memory(&memory)
+            , m_values(memory.allocate())
+            , m_pageNodes()
             {}
 
+            Chunk(const Chunk&) = delete;
+            Chunk& operator=(const Chunk&) = delete;
+
+            ~Chunk() {
+                m_memory->deallocate(m_values);
+            }
+
             result_type
             next() {
                 assert(!empty());
                 return m_values[m_nextIndex++];
             }
 
+            // Returns up to count of the remaining values and marks them as consumed.
+            std::span<const result_type>
+            take(size_t count) {
+                assert(!empty());
+                const size_t taken = std::min(count, remaining());
+                const std::span<const result_type> values{m_values + m_nextIndex, taken};
+                m_nextIndex += taken;
+                return values;
+            }
+
+            size_t
+            remaining() const {
+                return size() - m_nextIndex;
+            }
+
             bool
             empty() const {
-                return m_nextIndex == m_values.size();
+                return m_nextIndex == size();
             }
 
-            bool
-            full() const {
-                return m_nextIndex == 0u;
+            // The node of each page of the chunk, looked up when first asked for since pages stay where
+            // they were first placed.
+            const std::vector<int>&
+            pageNodes() {
+                if (m_pageNodes.empty()) {
+                    m_pageNodes = detail::pageNodes(m_values, size() * sizeof(result_type));
+                }
+                return m_pageNodes;
             }
 
-            void
-            fill(std::function<result_type(void)> generator) {
-                std::ranges::generate(m_values, generator);
+            // Fills the chunk a block at a time so that a shutdown request does not have to wait for a whole
+            // chunk to be generated. The generator is called with each block as a span to write into.
+            // Returns false, leaving the chunk empty, if interrupted.
+            template<std::invocable<std::span<result_type>> GeneratorT>
+            bool
+            fill(GeneratorT&& generator, const std::atomic<bool>& interrupt) {
+                const std::span<result_type, CHUNK_SIZE> values{m_values, size()};
+                for (size_t begin = 0; begin < values.size(); begin += FILL_BLOCK_SIZE) {
+                    if (interrupt.load(std::memory_order_relaxed)) {
+                        return false;
+                    }
+                    generator(values.subspan(begin, std::min(FILL_BLOCK_SIZE, values.size() - begin)));
+                }
                 m_nextIndex = 0;
+                return true;
             }
 
         private:
-            using storage_t = std::array<result_type, CHUNK_SIZE>;
+            static constexpr size_t FILL_BLOCK_SIZE = 4096;
+
+            // A compile time constant unless the chunk size is chosen at runtime.
+            size_t
+            size() const {
+                if constexpr (CHUNK_SIZE == std::dynamic_extent) {
+                    return m_size;
+                } else {
+                    return CHUNK_SIZE;
+                }
+            }
 
+            size_t m_size;
             size_t m_nextIndex;
-            storage_t m_values;
+            ChunkMemory* m_memory;
+            result_type* m_values;
+            std::vector<int> m_pageNodes;
         };
 
         class Producer {
         public:
-            using pointer = std::unique_ptr<Producer>;
-            using container = std::vector<pointer>;
-
-            Producer(const DistributionT& distribution, seed_type seed)
-            : m_mutex()
-            , m_conditionVariable()
-            , m_shutdown(false)
-            , m_chunk(std::make_unique<Chunk>())
+            using pointer = std::unique_ptr<Producer, Deleter>;
+            using container = std::vector<pointer, Allocator<pointer>>;
+
+            // Shared by the producers of a sequenced pipeline. Chunk c of the sequence is read from ring
+            // position c / N of producer c % N, but filled by whichever producer claims it first. The values
+            // themselves are generated in blocks of SEQUENCE_BLOCK_SIZE values, each from an engine seeded for
+            // the block's index, so that they depend neither on the thread count nor on the chunk size.
+            struct Sequencer {
+                const container* producers;
+                seed_type seed;
+                alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> nextChunk{0};
+            };
+
+            Producer(
+                const DistributionT& distribution,
+                seed_type seed,
+                const Options& options,
+                const std::vector<unsigned>& cpus,
+                ChunkMemory& memory,
+                Sequencer* sequencer,
+                size_t index)
+            : m_shutdown(false)
+            , m_busy()
+            , m_started(false)
+            , m_allocateFlag()
+            , m_startFlag()
+            , m_writeCount(0)
+            , m_releaseCount(0)
+            , m_readCount(0)
+            , m_slots(options.queueDepth, Allocator<Slot>{memory.allocator()})
+            , m_memory(&memory)
+            , m_ownThread(!options.pool)
+            , m_cpus(cpus)
+            , m_sequencer(sequencer)
+            , m_index(index)
+            , m_nextValue(0)
+            , m_bufferedBlock(NO_BLOCK)
+            , m_buffer(sequencer ? SEQUENCE_BLOCK_SIZE : 0, Allocator<result_type>{memory.allocator()})
             , m_distribution(distribution)
             , m_engine(seed)
-            , m_thread([this](){ run(); })
-            {}
+            , m_thread()
+            {
+                for (size_t i = 0; i < m_slots.size(); ++i) {
+                    m_slots[i].sequence.store(2 * i, std::memory_order_relaxed);
+                }
+            }
 
             ~Producer() {
                 stop();
             }
 
+            // Consumer side. Swaps otherChunk for the chunk at the given read position, which each consumer gets
+            // from the pipeline's ticket counter so that no two consumers ask for the same position.
+            // Returns true if the consumer stalled waiting for the chunk to be filled.
+            bool
+            swapChunk(uint64_t position, Chunk::pointer& otherChunk) {
+                Slot& slot = slotAt(position);
+                const uint64_t ready = 2 * position + 1;
+                const bool stalled = slot.sequence.load(std::memory_order_acquire) != ready;
+                if (!waitForSequence<WaitPolicyT>(slot, ready)) {
+                    throw std::logic_error{"threaded_rng_cache::RngCache: Illegal access of closed instance."};
+                }
+                release(slot, position, otherChunk);
+                return stalled;
+            }
+
+            // Consumer side. Whether the chunk at the given read position has been filled. Once it has, it stays
+            // ready until the consumer holding the position's ticket takes it.
+            bool
+            ready(uint64_t position) {
+                const uint64_t sequence = slotAt(position).sequence.load(std::memory_order_acquire);
+                if (sequence == CLOSED) {
+                    throw std::logic_error{"threaded_rng_cache::RngCache: Illegal access of closed instance."};
+                }
+                return sequence == 2 * position + 1;
+            }
+
+            // Unordered consumer side. Claims the next read position if its chunk is ready.
+            std::optional<uint64_t>
+            tryClaim() {
+                uint64_t position = m_readCount.load(std::memory_order_relaxed);
+                if (!ready(position)
+                    || !m_readCount.compare_exchange_strong(position, position + 1, std::memory_order_relaxed)) {
+                    return std::nullopt;
+                }
+                return position;
+            }
+
+            // Unordered consumer side. Claims the next read position whether or not its chunk is ready.
+            uint64_t
+            claim() {
+                return m_readCount.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            uint64_t
+            readCount() const {
+                return m_readCount.load(std::memory_order_relaxed);
+            }
+
+            // Allocates the chunks. Safe to call from any thread and any number of times; only the first call
+            // does anything.
+            void
+            allocateChunks() {
+                std::call_once(m_allocateFlag, [&](){
+                    for (Slot& slot : m_slots) {
+                        slot.chunk = detail::allocateUnique<Chunk>(m_memory->allocator(), *m_memory);
+                    }
+                });
+            }
+
+            // Allocates the chunks if not done yet and, unless running on a pool, starts the thread filling them.
+            // Safe to call from any consumer thread and any number of times; only the first call does anything.
+            // Only the pipeline calls it, as the producers of a sequenced pipeline fill each other's chunks and
+            // rely on the pipeline having allocated them all first. Returns whether this call started the producer.
+            bool
+            start() {
+                bool started = false;
+                std::call_once(m_startFlag, [&](){
+                    allocateChunks();
+                    if (m_ownThread) {
+                        m_thread = std::thread{[this](){ run(); }};
+                    }
+                    m_started.store(true, std::memory_order_release);
+                    started = true;
+                });
+                return started;
+            }
+
+            // Pool side. Fills the next chunk if its slot is free and no other worker is filling this producer.
+            bool
+            tryProduce() {
+                if (!m_started.load(std::memory_order_acquire) || m_busy.test_and_set(std::memory_order_acquire)) {
+                    return false;
+                }
+                const uint64_t position = m_writeCount.load(std::memory_order_relaxed);
+                Slot& slot = slotAt(position);
+                const bool produced = !m_shutdown.load()
+                    && slot.sequence.load(std::memory_order_acquire) == 2 * position
+                    && produce(slot, position, *this);
+                m_busy.clear(std::memory_order_release);
+                return produced;
+            }
+
+            // Number of chunks this producer has filled so far, which is also the read position of its next chunk.
+            uint64_t
+            writeCount() const {
+                return m_writeCount.load(std::memory_order_relaxed);
+            }
+
+            // Filled chunks not yet taken by a consumer. Only a snapshot when read from another thread.
+            size_t
+            readyChunks() const {
+                const uint64_t released = m_releaseCount.load(std::memory_order_relaxed);
+                const uint64_t written = m_writeCount.load(std::memory_order_relaxed);
+                return written > released ? written - released : 0;
+            }
+
+            // Waits until the chunks at all ring positions from the given read position on have been filled,
+            // or have already been taken by a consumer.
             void
-            swapChunk(Chunk::pointer& otherChunk) {
-                {
-                    std::unique_lock lock{m_mutex};
-                    m_conditionVariable.wait(lock, [this](){ return swapWaitCondition(); });
-                    if (m_shutdown) {
-                        throw std::logic_error{"threaded_rng_cache::RngCache: Illegal access of closed instance."};
+            waitUntilFull(uint64_t readPosition) {
+                for (uint64_t position = readPosition; position < readPosition + m_slots.size(); ++position) {
+                    Slot& slot = slotAt(position);
+                    uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+                    while (sequence < 2 * position + 1 && !m_shutdown.load()) {
+                        slot.sequence.wait(sequence, std::memory_order_acquire);
+                        sequence = slot.sequence.load(std::memory_order_acquire);
                     }
-                    std::swap(m_chunk, otherChunk);
                 }
-                m_conditionVariable.notify_one();
+            }
+
+            // Interrupts a fill in progress without waiting for the producer to finish.
+            void
+            requestStop() {
+                m_shutdown.store(true);
+            }
+
+            // Stops the producer and wakes everyone waiting for its slots without waiting for its thread, which
+            // may itself be waiting for the slot of another producer of a sequenced pipeline.
+            void
+            close() {
+                m_shutdown.store(true);
+                for (Slot& slot : m_slots) {
+                    slot.sequence.store(CLOSED, std::memory_order_release);
+                    slot.sequence.notify_all();
+                }
+            }
+
+            // Closes the producer and waits for its thread to finish.
+            void
+            stop() {
+                close();
+                if (m_thread.joinable()) {
+                    m_thread.join();
+                }
             }
 
             static container
-            create(const DistributionT& distribution, seed_type seed, size_t count) {
+            create(
+                const DistributionT& distribution,
+                seed_type seed,
+                size_t count,
+                const Options& options,
+                ChunkMemory& memory,
+                Sequencer* sequencer)
+            {
                 EngineT rootEngine{seed};
-                container producers{count};
-                std::ranges::generate(producers, [&](){
+                const std::vector<std::vector<unsigned>> placement = threadPlacement(count, options, memory.binding());
+                container producers{Allocator<pointer>{memory.allocator()}};
+                producers.reserve(count);
+                for (size_t i = 0; i < count; ++i) {
                     const seed_type childSeed = rootEngine();
-                    return std::make_unique<Producer>(distribution, childSeed);
-                });
+                    producers.push_back(detail::allocateUnique<Producer>(
+                        memory.allocator(), distribution, childSeed, options, placement[i], memory, sequencer, i));
+                }
                 return producers;
             }
         private:
+            // Each slot carries a sequence number telling which side owns it. A slot at ring position n is free
+            // for the producer when its sequence is 2n and ready for the consumer when it is 2n + 1. Releasing a
+            // slot moves its sequence a full lap ahead, so every waiter only ever waits for a single value.
+            // Consumers waiting for a later lap may share a slot with the producer, so slots are always
+            // notified with notify_all.
+            struct alignas(CACHE_LINE_SIZE) Slot {
+                std::atomic<uint64_t> sequence;
+                Chunk::pointer chunk;
+            };
 
-            void
-            stop() {
-                {
-                    std::lock_guard lock{m_mutex};
-                    m_shutdown = true;
+            static constexpr uint64_t CLOSED = std::numeric_limits<uint64_t>::max();
+            static constexpr uint64_t SEQUENCE_BLOCK_SIZE = 4096;
+            static constexpr uint64_t NO_BLOCK = std::numeric_limits<uint64_t>::max();
+
+            // With the chunks bound to the consumer's node and no explicit affinity, the producers are kept on
+            // that node too so that filling the chunks does not cross the interconnect.
+            static std::vector<std::vector<unsigned>>
+            threadPlacement(size_t count, const Options& options, const detail::NodeBinding& binding) {
+                if (options.pool) {
+                    return std::vector<std::vector<unsigned>>(count);
+                }
+                if (options.affinity.policy == Affinity::Policy::None
+                    && binding.mode == detail::NodeBinding::PREFERRED) {
+                    const std::optional<unsigned> node = detail::currentNode();
+                    if (node) {
+                        return std::vector<std::vector<unsigned>>(count, detail::nodeCpus(*node));
+                    }
                 }
-                m_conditionVariable.notify_one();
-                m_thread.join();
+                return detail::placement(options.affinity, count);
+            }
+
+            Slot&
+            slotAt(uint64_t position) {
+                return m_slots[position % m_slots.size()];
+            }
+
+            // Swaps otherChunk for the ready chunk in the slot and hands the slot back to the producer.
+            void
+            release(Slot& slot, uint64_t position, Chunk::pointer& otherChunk) {
+                std::swap(slot.chunk, otherChunk);
+                slot.sequence.store(2 * (position + m_slots.size()), std::memory_order_release);
+                slot.sequence.notify_all();
+                m_releaseCount.fetch_add(1, std::memory_order_relaxed);
             }
 
+            // Waits until the slot reaches the expected sequence. Returns false if the producer is shutting down.
+            template<typename WaitPolicy>
             bool
-            swapWaitCondition() const {
-                return m_shutdown || m_chunk->full();
+            waitForSequence(Slot& slot, uint64_t expected) {
+                const uint64_t sequence = WaitPolicy::wait(slot.sequence, [&](uint64_t value){
+                    return value == expected || value == CLOSED || m_shutdown.load();
+                });
+                return sequence == expected;
             }
 
+            // Fills the free slot at the given write position with values from filler, which is this producer
+            // unless sequenced, and hands it to the consumers. Returns false if interrupted by a shutdown.
             bool
-            fillWaitCondition() const {
-                return m_shutdown || m_chunk->empty();
+            produce(Slot& slot, uint64_t position, Producer& filler) {
+                if (m_sequencer) {
+                    filler.seek((position * m_sequencer->producers->size() + m_index) * m_memory->chunkSize());
+                }
+                const auto generate = [&filler](std::span<result_type> values){ filler.generate(values); };
+                if (!slot.chunk->fill(generate, filler.m_shutdown)) {
+                    return false;
+                }
+                slot.sequence.store(2 * position + 1, std::memory_order_release);
+                slot.sequence.notify_all();
+                m_writeCount.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+
+            // Sequenced producers. Moves on to the given index in the sequence of values.
+            void
+            seek(uint64_t value) {
+                m_nextValue = value;
+            }
+
+            // Seeds the engine for the given block of the sequence, independently of the blocks before it.
+            void
+            seekBlock(uint64_t block) {
+                if constexpr (StreamEngine<EngineT>) {
+                    m_engine = EngineT{m_sequencer->seed};
+                    m_engine.set_stream(block);
+                } else {
+                    m_engine = EngineT{static_cast<seed_type>(
+                        detail::splitMix64(static_cast<uint64_t>(m_sequencer->seed) ^ detail::splitMix64(block)))};
+                }
+                if constexpr (requires { m_distribution.reset(); }) {
+                    m_distribution.reset();
+                }
             }
 
             void
             run() {
-                while (true) {
-                    {
-                        std::unique_lock lock{m_mutex};
-                        m_conditionVariable.wait(lock, [this](){ return fillWaitCondition(); });
-                        if (m_shutdown) {
-                            return;
+                detail::pin(m_cpus);
+                if (m_sequencer) {
+                    runSequenced();
+                    return;
+                }
+                while (!m_shutdown.load()) {
+                    const uint64_t position = m_writeCount.load(std::memory_order_relaxed);
+                    Slot& slot = slotAt(position);
+                    if (!waitForSequence<BlockingWait>(slot, 2 * position) || !produce(slot, position, *this)) {
+                        return;
+                    }
+                }
+            }
+
+            // Claims the next chunk of the sequence and fills it into the ring it is read from, whichever
+            // producer that is, so that the others carry on with the following chunks while one is descheduled.
+            // The pipeline allocates the chunks of all producers before starting any of them.
+            void
+            runSequenced() {
+                const container& producers = *m_sequencer->producers;
+                while (!m_shutdown.load()) {
+                    const uint64_t chunk = m_sequencer->nextChunk.fetch_add(1, std::memory_order_relaxed);
+                    Producer& target = *producers[chunk % producers.size()];
+                    const uint64_t position = chunk / producers.size();
+                    Slot& slot = target.slotAt(position);
+                    if (!target.template waitForSequence<BlockingWait>(slot, 2 * position)
+                        || !target.produce(slot, position, *this)) {
+                        return;
+                    }
+                }
+            }
+
+            void
+            generate(std::span<result_type> values) {
+                if (m_sequencer) {
+                    generateSequenced(values);
+                } else {
+                    generateValues(values);
+                }
+            }
+
+            // Generates each block of the sequence with a single call, straight into the chunk where it covers
+            // a whole block and through the buffer where a chunk starts or ends within a block, so that the
+            // values do not depend on where the chunk boundaries fall.
+            void
+            generateSequenced(std::span<result_type> values) {
+                while (!values.empty()) {
+                    const uint64_t block = m_nextValue / SEQUENCE_BLOCK_SIZE;
+                    const size_t offset = m_nextValue % SEQUENCE_BLOCK_SIZE;
+                    const size_t count = std::min<size_t>(values.size(), SEQUENCE_BLOCK_SIZE - offset);
+                    if (count == SEQUENCE_BLOCK_SIZE) {
+                        seekBlock(block);
+                        generateValues(values.first(count));
+                    } else {
+                        if (block != m_bufferedBlock) {
+                            seekBlock(block);
+                            generateValues(m_buffer);
+                            m_bufferedBlock = block;
                         }
-                        m_chunk->fill([this](){ return generate(); });
+                        std::copy_n(m_buffer.begin() + offset, count, values.begin());
                     }
-                    m_conditionVariable.notify_one();
+                    values = values.subspan(count);
+                    m_nextValue += count;
                 }
             }
 
-            result_type
-            generate() {
-                return m_distribution(m_engine);
+            void
+            generateValues(std::span<result_type> values) {
+                if constexpr (BatchDistribution<DistributionT, EngineT>) {
+                    m_distribution.generate(values, m_engine);
+                } else if constexpr (BatchEngine<EngineT>) {
+                    detail::BufferedEngine<EngineT> engine{m_engine};
+                    for (result_type& value : values) {
+                        value = m_distribution(engine);
+                    }
+                } else {
+                    for (result_type& value : values) {
+                        value = m_distribution(m_engine);
+                    }
+                }
             }
 
-            std::mutex m_mutex;
-            std::condition_variable m_conditionVariable;
-            bool m_shutdown;
-            Chunk::pointer m_chunk;
+            std::atomic<bool> m_shutdown;
+            std::atomic_flag m_busy;
+            std::atomic<bool> m_started;
+            std::once_flag m_allocateFlag;
+            std::once_flag m_startFlag;
+            alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_writeCount;
+            alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_releaseCount;
+            // Next read position handed to a consumer. Only used by unordered pipelines, which claim positions
+            // from each producer directly instead of through the ticket counter.
+            alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_readCount;
+            std::vector<Slot, Allocator<Slot>> m_slots;
+            ChunkMemory* m_memory;
+            bool m_ownThread;
+            std::vector<unsigned> m_cpus;
+            Sequencer* m_sequencer;
+            size_t m_index;
+            uint64_t m_nextValue;
+            uint64_t m_bufferedBlock;
+            std::vector<result_type, Allocator<result_type>> m_buffer;
             DistributionT m_distribution;
             EngineT m_engine;
             std::thread m_thread;
         };
 
+        // The producers together with the ticket counter that hands their chunks out to the consumers in
+        // round-robin order. Ticket t refers to read position t / N of producer t % N. When the cache runs on
+        // a ProducerPool the pipeline is the job the pool's workers fill chunks for.
+        class Pipeline : public ProducerPool::Job {
+        public:
+            using pointer = std::unique_ptr<Pipeline>;
+
+            Pipeline(
+                const DistributionT& distribution,
+                seed_type seed,
+                size_t threadCount,
+                const Options& options,
+                const AllocatorT& allocator)
+            : m_memory(
+                chunkSize(options),
+                options.hugePages,
+                options.numa,
+                options.prefault,
+                options.lockMemory,
+                Allocator<result_type>{allocator})
+            , m_distribution(distribution)
+            , m_fallbackMutex()
+            , m_fallbackSeeds(static_cast<seed_type>(~seed))
+            , m_numaStatistics(options.numa.statistics)
+            , m_sequencer{&m_producers, seed}
+            , m_producers(Producer::create(
+                distribution,
+                seed,
+                threadCount,
+                options,
+                m_memory,
+                options.ordering == Ordering::Sequenced ? &m_sequencer : nullptr))
+            , m_queueDepth(options.queueDepth)
+            , m_lazyStart(options.lazyStart)
+            , m_ordering(options.ordering)
+            , m_pool(options.pool)
+            , m_nextTicket(0)
+            {
+                if (!m_lazyStart) {
+                    startAllProducers();
+                }
+                if (m_pool) {
+                    m_pool->attach(*this);
+                }
+                if (options.prefault || options.lockMemory) {
+                    waitUntilReady();
+                }
+            }
+
+            ~Pipeline() override {
+                if (m_ordering == Ordering::Sequenced) {
+                    // All threads have to be woken before any is joined, and joined before any producer is
+                    // destroyed, as each may be filling or waiting for the chunks of any other.
+                    for (const auto& producer : m_producers) {
+                        producer->close();
+                    }
+                    for (const auto& producer : m_producers) {
+                        producer->stop();
+                    }
+                }
+                if (m_pool) {
+                    for (const auto& producer : m_producers) {
+                        producer->requestStop();
+                    }
+                    m_pool->detach(*this);
+                }
+            }
+
+            // Swaps chunk for the next chunk in the round-robin order. Returns true if the consumer stalled
+            // waiting for it.
+            bool
+            swapChunk(Chunk::pointer& chunk) {
+                if (m_ordering == Ordering::Unordered) {
+                    return swapAnyChunk(chunk);
+                }
+                const uint64_t ticket = m_nextTicket.fetch_add(1, std::memory_order_relaxed);
+                startProducers(ticket);
+                Producer& producer = *m_producers[ticket % m_producers.size()];
+                const bool stalled = producer.swapChunk(ticket / m_producers.size(), chunk);
+                swapped(stalled);
+                return stalled;
+            }
+
+            // Swaps chunk for the next chunk in the round-robin order if it is ready, without waiting. The ticket
+            // is only claimed once the chunk is known to be ready, so that a consumer giving up never leaves a
+            // claimed chunk behind for the others to wait on. Returns whether it swapped.
+            bool
+            trySwapChunk(Chunk::pointer& chunk) {
+                if (m_ordering == Ordering::Unordered) {
+                    // Start the producers the rotation has reached and move the rotation on after each swap, so
+                    // that consumers that never wait still start all producers of a lazy pipeline in turn.
+                    const uint64_t ticket = m_nextTicket.load(std::memory_order_relaxed);
+                    startProducers(ticket);
+                    if (!trySwapAnyChunk(ticket, chunk)) {
+                        return false;
+                    }
+                    m_nextTicket.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+                uint64_t ticket = m_nextTicket.load(std::memory_order_relaxed);
+                startProducers(ticket);
+                Producer& producer = *m_producers[ticket % m_producers.size()];
+                const uint64_t position = ticket / m_producers.size();
+                if (!producer.ready(position)
+                    || !m_nextTicket.compare_exchange_strong(ticket, ticket + 1, std::memory_order_relaxed)) {
+                    return false;
+                }
+                producer.swapChunk(position, chunk);
+                swapped(false);
+                return true;
+            }
+
+            const DistributionT&
+            distribution() const {
+                return m_distribution;
+            }
+
+            // Counts a consumer that found its next chunk not ready and fell back or gave up instead of waiting
+            // as a stall, so that an adaptive pool grows for non-blocking consumers too.
+            void
+            missed() {
+                swapped(true);
+            }
+
+            // Seeds for the fallback engines of NonBlockingWait consumers, one per handle.
+            seed_type
+            fallbackSeed() {
+                std::lock_guard lock{m_fallbackMutex};
+                return m_fallbackSeeds();
+            }
+
+            // Waits until every producer has filled all the chunks it may keep ready.
+            void
+            waitUntilReady() {
+                const uint64_t ticket = m_nextTicket.load(std::memory_order_relaxed);
+                const size_t count = m_producers.size();
+                startAllProducers();
+                for (size_t i = 0; i < count; ++i) {
+                    // In round-robin order the read position of producer i is the number of tickets so far
+                    // referring to it.
+                    m_producers[i]->waitUntilFull(m_ordering == Ordering::Unordered
+                        ? m_producers[i]->readCount()
+                        : (ticket + count - 1 - i) / count);
+                }
+            }
+
+            static size_t
+            chunkSize(const Options& options) {
+                if constexpr (CHUNK_SIZE == std::dynamic_extent) {
+                    if (options.chunkSize != 0) {
+                        return options.chunkSize;
+                    }
+                    return std::max<size_t>(detail::defaultChunkBytes() / sizeof(result_type), 1);
+                } else {
+                    return CHUNK_SIZE;
+                }
+            }
+
+            ChunkMemory&
+            memory() {
+                return m_memory;
+            }
+
+            bool
+            numaStatistics() const {
+                return m_numaStatistics;
+            }
+
+            double
+            fillLevel() const override {
+                size_t ready = 0;
+                for (const auto& producer : m_producers) {
+                    ready += producer->readyChunks();
+                }
+                return static_cast<double>(ready) / static_cast<double>(m_producers.size() * m_queueDepth);
+            }
+
+            // Fills the chunk the consumers will reach first, which is the producer with the lowest
+            // write position, falling back to the following producers if it is busy or full.
+            bool
+            produce() override {
+                const size_t count = m_producers.size();
+                size_t first = 0;
+                for (size_t i = 1; i < count; ++i) {
+                    if (m_producers[i]->writeCount() < m_producers[first]->writeCount()) {
+                        first = i;
+                    }
+                }
+                for (size_t i = 0; i < count; ++i) {
+                    if (m_producers[(first + i) % count]->tryProduce()) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+        private:
+            // Unordered swap. Takes the first ready chunk, looking at the producers in turn from a different one
+            // each time, and only waits for a producer if none has a chunk ready. The ticket counter then merely
+            // rotates the producer to start from and to wait for.
+            bool
+            swapAnyChunk(Chunk::pointer& chunk) {
+                const uint64_t ticket = m_nextTicket.fetch_add(1, std::memory_order_relaxed);
+                if (trySwapAnyChunk(ticket, chunk)) {
+                    return false;
+                }
+                startProducers(ticket);
+                Producer& producer = *m_producers[ticket % m_producers.size()];
+                const bool stalled = producer.swapChunk(producer.claim(), chunk);
+                swapped(stalled);
+                return stalled;
+            }
+
+            bool
+            trySwapAnyChunk(uint64_t ticket, Chunk::pointer& chunk) {
+                const size_t count = m_producers.size();
+                for (size_t i = 0; i < count; ++i) {
+                    Producer& producer = *m_producers[(ticket + i) % count];
+                    if (const std::optional<uint64_t> position = producer.tryClaim()) {
+                        producer.swapChunk(*position, chunk);
+                        swapped(false);
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            void
+            startProducers(uint64_t ticket) {
+                if (m_lazyStart && m_ordering == Ordering::Sequenced) {
+                    // Any producer of a sequenced pipeline may fill the chunks of any other, so all start at once.
+                    startAllProducers();
+                } else if (m_lazyStart) {
+                    // Start the producer asked now along with the one asked next, so that the next swap finds
+                    // a producer already at work.
+                    startProducer(*m_producers[ticket % m_producers.size()]);
+                    startProducer(*m_producers[(ticket + 1) % m_producers.size()]);
+                }
+            }
+
+            // Allocates the chunks of all producers before starting any, so that no producer of a sequenced
+            // pipeline can reach the chunks of another that has not been started yet. Consumers never start
+            // producers after the pipeline has begun to close them, as that only happens on destruction.
+            void
+            startAllProducers() {
+                for (const auto& producer : m_producers) {
+                    producer->allocateChunks();
+                }
+                for (const auto& producer : m_producers) {
+                    startProducer(*producer);
+                }
+            }
+
+            // Pool workers skip producers that have not started, so they are woken when one does, since they
+            // may otherwise sleep through its first chunks.
+            void
+            startProducer(Producer& producer) {
+                if (producer.start() && m_pool) {
+                    m_pool->wake();
+                }
+            }
+
+            void
+            swapped(bool stalled) {
+                if (m_pool) {
+                    m_pool->recordSwap(stalled);
+                    m_pool->wake();
+                }
+            }
+
+            ChunkMemory m_memory;
+            DistributionT m_distribution;
+            std::mutex m_fallbackMutex;
+            // Seeded apart from the producers' root engine so that fallback values do not repeat chunk values.
+            EngineT m_fallbackSeeds;
+            bool m_numaStatistics;
+            Producer::Sequencer m_sequencer;
+            Producer::container m_producers;
+            size_t m_queueDepth;
+            bool m_lazyStart;
+            Ordering m_ordering;
+            std::shared_ptr<ProducerPool> m_pool;
+            alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_nextTicket;
+        };
+
         static seed_type
         randomSeed() {
             using Device = std::random_device;
@@ -224,27 +2349,36 @@ namespace threaded_rng_cache
             return seed;
         }
 
-        Producer&
-        nextProducer() {
-            Producer& producer = **m_nextProducer++;
-            if (m_nextProducer == m_producers.end()) {
-                m_nextProducer = m_producers.begin();
+        static const Options&
+        validate(size_t threadCount, const Options& options) {
+            if (threadCount == 0) {
+                throw std::invalid_argument{"threaded_rng_cache::RngCache: Thread count must be at least one."};
             }
-            return producer;
+            if (options.queueDepth == 0) {
+                throw std::invalid_argument{"threaded_rng_cache::RngCache: Queue depth must be at least one."};
+            }
+            if (CHUNK_SIZE != std::dynamic_extent && options.chunkSize != 0) {
+                throw std::invalid_argument{
+                    "threaded_rng_cache::RngCache: Chunk size can only be set with CHUNK_SIZE = std::dynamic_extent."};
+            }
+            if (options.adaptiveThreads && options.pool) {
+                throw std::invalid_argument{"threaded_rng_cache::RngCache: Adaptive threads require a private pool."};
+            }
+            return options;
         }
 
-        result_type
-        generate() {
-            if (m_activeChunk->empty()) {
-                Producer& producer = nextProducer();
-                producer.swapChunk(m_activeChunk);
+        // Replaces the dedicated producer threads of adaptive caches with a private adaptive pool.
+        static Options
+        withAdaptivePool(size_t threadCount, Options options) {
+            if (options.adaptiveThreads) {
+                options.pool = std::make_shared<ProducerPool>(
+                    std::min(options.minThreads, threadCount), threadCount, options.affinity);
             }
-            return m_activeChunk->next();
+            return options;
         }
 
-        Chunk::pointer m_activeChunk;
-        Producer::container m_producers;
-        Producer::container::iterator m_nextProducer;
+        Pipeline::pointer m_pipeline;
+        Handle m_consumer;
     };
 
 
@@ -0,0 +1,267 @@
+/*
+MIT License
+
+Copyright (c) 2023 Robin Åstedt
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <array>
+#include <span>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+
+// Counter-based engines, which generate each block of values by encrypting its index with the seed as the key.
+// Unlike std::mt19937_64 they can move to any position in constant time, which lets sequenced caches position
+// the engine for each block of the sequence without reseeding it, and their state fits in a few registers.
+//
+// Both engines split their counter into 2^64 independent streams, selected with set_stream, of 2^64 blocks
+// each, and return 64-bit values so that they can be seeded with a full 64-bit seed.
+
+namespace threaded_rng_cache
+{
+    namespace detail
+    {
+        // The generation shared by the counter-based engines. BijectionT maps a counter and key to a block of
+        // BLOCK_SIZE values.
+        template<typename BijectionT>
+        class CounterEngine {
+        public:
+            using result_type = uint64_t;
+
+            static constexpr size_t BLOCK_SIZE = BijectionT::BLOCK_SIZE;
+
+            CounterEngine()
+            : CounterEngine(0)
+            {}
+
+            explicit CounterEngine(result_type seed)
+            : m_key(BijectionT::key(seed))
+            , m_stream(0)
+            , m_position(0)
+            , m_bufferedBlock(std::numeric_limits<uint64_t>::max())
+            , m_buffer()
+            {}
+
+            static constexpr result_type
+            min() {
+                return std::numeric_limits<result_type>::min();
+            }
+
+            static constexpr result_type
+            max() {
+                return std::numeric_limits<result_type>::max();
+            }
+
+            result_type
+            operator()() {
+                const uint64_t block = m_position / BLOCK_SIZE;
+                if (block != m_bufferedBlock) {
+                    m_buffer = BijectionT::generate(block, m_stream, m_key);
+                    m_bufferedBlock = block;
+                }
+                return m_buffer[m_position++ % BLOCK_SIZE];
+            }
+
+            // Fills values with the next values.size() values, generating whole blocks straight into it.
+            void
+            generate(std::span<result_type> values) {
+                size_t i = 0;
+                for (; i < values.size() && m_position % BLOCK_SIZE != 0; ++i) {
+                    values[i] = (*this)();
+                }
+                for (; values.size() - i >= BLOCK_SIZE; i += BLOCK_SIZE) {
+                    const std::array<result_type, BLOCK_SIZE> block =
+                        BijectionT::generate(m_position / BLOCK_SIZE, m_stream, m_key);
+                    std::ranges::copy(block, values.begin() + i);
+                    m_position += BLOCK_SIZE;
+                }
+                for (; i < values.size(); ++i) {
+                    values[i] = (*this)();
+                }
+            }
+
+            void
+            seed(result_type seed = 0) {
+                *this = CounterEngine{seed};
+            }
+
+            // Skips count values in constant time.
+            void
+            discard(unsigned long long count) {
+                m_position += count;
+            }
+
+            // Moves to the start of the given stream in constant time.
+            void
+            set_stream(uint64_t stream) {
+                m_stream = stream;
+                m_position = 0;
+                m_bufferedBlock = std::numeric_limits<uint64_t>::max();
+            }
+
+            uint64_t
+            stream() const {
+                return m_stream;
+            }
+
+            // Number of values generated or discarded since the start of the stream.
+            uint64_t
+            position() const {
+                return m_position;
+            }
+
+            friend bool
+            operator==(const CounterEngine& lhs, const CounterEngine& rhs) {
+                return lhs.m_key == rhs.m_key && lhs.m_stream == rhs.m_stream && lhs.m_position == rhs.m_position;
+            }
+
+        private:
+            BijectionT::key_type m_key;
+            uint64_t m_stream;
+            uint64_t m_position;
+            uint64_t m_bufferedBlock;
+            std::array<result_type, BLOCK_SIZE> m_buffer;
+        };
+
+        // Philox4x32-10 from Salmon et al., "Parallel random numbers: as easy as 1, 2, 3" (SC '11). The 128-bit
+        // counter holds the block index in its low and the stream in its high 64 bits.
+        struct Philox4x32Bijection {
+            using key_type = std::array<uint32_t, 2>;
+
+            static constexpr size_t BLOCK_SIZE = 2;
+
+            static key_type
+            key(uint64_t seed) {
+                return {static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)};
+            }
+
+            static std::array<uint64_t, BLOCK_SIZE>
+            generate(uint64_t block, uint64_t stream, key_type key) {
+                std::array<uint32_t, 4> counter{
+                    static_cast<uint32_t>(block),
+                    static_cast<uint32_t>(block >> 32),
+                    static_cast<uint32_t>(stream),
+                    static_cast<uint32_t>(stream >> 32),
+                };
+                counter = encrypt(counter, key);
+                return {
+                    static_cast<uint64_t>(counter[1]) << 32 | counter[0],
+                    static_cast<uint64_t>(counter[3]) << 32 | counter[2],
+                };
+            }
+
+            static std::array<uint32_t, 4>
+            encrypt(std::array<uint32_t, 4> counter, key_type key) {
+                constexpr uint64_t multiplier0 = 0xD2511F53;
+                constexpr uint64_t multiplier1 = 0xCD9E8D57;
+                constexpr uint32_t weyl0 = 0x9E3779B9;
+                constexpr uint32_t weyl1 = 0xBB67AE85;
+
+                for (size_t round = 0; round < 10; ++round) {
+                    if (round > 0) {
+                        key[0] += weyl0;
+                        key[1] += weyl1;
+                    }
+                    const uint64_t product0 = multiplier0 * counter[0];
+                    const uint64_t product1 = multiplier1 * counter[2];
+                    counter = {
+                        static_cast<uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+                        static_cast<uint32_t>(product1),
+                        static_cast<uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+                        static_cast<uint32_t>(product0),
+                    };
+                }
+                return counter;
+            }
+        };
+
+        // Threefry4x64-20 from the same paper, built on the Threefish block cipher. The 256-bit counter holds
+        // the block index in its first and the stream in its second word.
+        struct Threefry4x64Bijection {
+            using key_type = std::array<uint64_t, 4>;
+
+            static constexpr size_t BLOCK_SIZE = 4;
+
+            static key_type
+            key(uint64_t seed) {
+                return {seed, 0, 0, 0};
+            }
+
+            static std::array<uint64_t, BLOCK_SIZE>
+            generate(uint64_t block, uint64_t stream, const key_type& key) {
+                return encrypt({block, stream, 0, 0}, key);
+            }
+
+            static std::array<uint64_t, 4>
+            encrypt(std::array<uint64_t, 4> counter, const key_type& key) {
+                constexpr unsigned rotations[8][2] = {
+                    {14, 16}, {52, 57}, {23, 40}, {5, 37}, {25, 33}, {46, 12}, {58, 22}, {32, 32},
+                };
+                const std::array<uint64_t, 5> schedule{
+                    key[0], key[1], key[2], key[3], 0x1BD11BDAA9FC1A22 ^ key[0] ^ key[1] ^ key[2] ^ key[3]};
+
+                std::array<uint64_t, 4> x = counter;
+                for (size_t i = 0; i < 4; ++i) {
+                    x[i] += schedule[i];
+                }
+                for (size_t round = 0; round < 20; ++round) {
+                    const unsigned* rotation = rotations[round % 8];
+                    if (round % 2 == 0) {
+                        x[0] += x[1];
+                        x[1] = rotl(x[1], rotation[0]) ^ x[0];
+                        x[2] += x[3];
+                        x[3] = rotl(x[3], rotation[1]) ^ x[2];
+                    } else {
+                        x[0] += x[3];
+                        x[3] = rotl(x[3], rotation[0]) ^ x[0];
+                        x[2] += x[1];
+                        x[1] = rotl(x[1], rotation[1]) ^ x[2];
+                    }
+                    if (round % 4 == 3) {
+                        // Inject the key schedule every four rounds.
+                        const size_t injection = round / 4 + 1;
+                        for (size_t i = 0; i < 4; ++i) {
+                            x[i] += schedule[(injection + i) % 5];
+                        }
+                        x[3] += injection;
+                    }
+                }
+                return x;
+            }
+
+            static constexpr uint64_t
+            rotl(uint64_t value, unsigned count) {
+                return value << count | value >> (64 - count);
+            }
+        };
+    } // namespace detail
+
+    // Philox4x32-10, returning each block's four 32-bit words as two 64-bit values. The faster of the two on
+    // CPUs with a fast 32-bit multiplier.
+    using Philox4x32 = detail::CounterEngine<detail::Philox4x32Bijection>;
+
+    // Threefry4x64-20, which only uses additions, rotations and xors.
+    using Threefry4x64 = detail::CounterEngine<detail::Threefry4x64Bijection>;
+
+} // namespace threaded_rng_cache
@@ -0,0 +1,277 @@
+
+#include <threaded_rng_cache.hpp>
+#include <threaded_rng_cache_engines.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <string>
+#include <thread>
+
+// Measures the throughput of RngCache on the current machine for a range of chunk sizes, thread counts and queue
+// depths, and writes the best configuration found as a header or as JSON.
+//
+// Usage: rng_cache_autotune [--distribution uniform_real|normal|uniform_int]
+//                           [--engine mt19937_64|philox4x32|threefry4x64] [--values N]
+//                           [--format header|json] [--output FILE]
+//
+// The progress is written to stderr, so that the result can be redirected from stdout when no output file is
+// given.
+//
+// The parameters are tuned one after another rather than over the full cross product: first the chunk size with
+// one producer per hardware thread, then the thread count with that chunk size and then the queue depth. Thread
+// counts and queue depths within TOLERANCE of the fastest are considered equal, and the smallest is taken.
+
+namespace {
+    constexpr double TOLERANCE = 0.05;
+
+    struct Arguments {
+        std::string distribution = "uniform_real";
+        std::string engine = "mt19937_64";
+        size_t values = 1 << 26;
+        std::string format = "header";
+        std::string output;
+    };
+
+    struct Configuration {
+        size_t chunkBytes = 128 * 1024;
+        size_t threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+        size_t queueDepth = 1;
+    };
+
+    struct Measurement {
+        Configuration configuration;
+        double valuesPerNanosecond = 0.0;
+    };
+
+    Arguments parseArguments(int argc, char** argv) {
+        Arguments arguments;
+        for (int i = 1; i < argc; ++i) {
+            const std::string argument = argv[i];
+            if (i + 1 == argc) {
+                throw std::invalid_argument{"Missing value for " + argument + "."};
+            }
+            const std::string value = argv[++i];
+            if (argument == "--distribution") {
+                arguments.distribution = value;
+            } else if (argument == "--engine") {
+                arguments.engine = value;
+            } else if (argument == "--values") {
+                arguments.values = std::stoull(value);
+            } else if (argument == "--format") {
+                arguments.format = value;
+            } else if (argument == "--output") {
+                arguments.output = value;
+            } else {
+                throw std::invalid_argument{"Unknown argument " + argument + "."};
+            }
+        }
+        if (arguments.format != "header" && arguments.format != "json") {
+            throw std::invalid_argument{"Unknown format " + arguments.format + "."};
+        }
+        return arguments;
+    }
+
+    // The engine's type name as written in the generated header, together with the header declaring it.
+    struct Engine {
+        std::string name;
+        std::string header;
+    };
+
+    template<typename EngineT, typename DistributionT>
+    Measurement measure(const DistributionT& distribution, const Configuration& configuration, size_t values) {
+        using result_type = DistributionT::result_type;
+
+        threaded_rng_cache::Options options;
+        options.chunkSize = std::max<size_t>(configuration.chunkBytes / sizeof(result_type), 1);
+        options.queueDepth = configuration.queueDepth;
+        options.prefill = true;
+        threaded_rng_cache::RngCache<DistributionT, EngineT, std::dynamic_extent> rngCache{
+            distribution, std::nullopt, configuration.threadCount, options};
+
+        result_type sum{};
+        const auto begin = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < values; ++i) {
+            sum += rngCache();
+        }
+        const std::chrono::duration<double, std::nano> duration = std::chrono::steady_clock::now() - begin;
+
+        const Measurement measurement{configuration, static_cast<double>(values) / duration.count()};
+        std::cerr << "Chunk size " << configuration.chunkBytes / 1024 << " KiB, "
+                  << configuration.threadCount << " threads, queue depth " << configuration.queueDepth << ": "
+                  << measurement.valuesPerNanosecond << " values/ns (sum " << sum << ")." << std::endl;
+        return measurement;
+    }
+
+    // Measures each candidate and returns the fastest or, with preferSmallest, the first one within TOLERANCE
+    // of the fastest, so that the candidates have to be given in increasing order of cost.
+    template<typename EngineT, typename DistributionT, typename SetT>
+    Measurement sweep(
+        const DistributionT& distribution,
+        const Configuration& base,
+        const std::vector<size_t>& candidates,
+        SetT&& set,
+        size_t values,
+        bool preferSmallest)
+    {
+        std::vector<Measurement> measurements;
+        for (size_t candidate : candidates) {
+            Configuration configuration = base;
+            set(configuration, candidate);
+            measurements.push_back(measure<EngineT>(distribution, configuration, values));
+        }
+        const Measurement& fastest = *std::ranges::max_element(measurements, {}, &Measurement::valuesPerNanosecond);
+        if (!preferSmallest) {
+            return fastest;
+        }
+        return *std::ranges::find_if(measurements, [&](const Measurement& measurement){
+            return measurement.valuesPerNanosecond >= (1.0 - TOLERANCE) * fastest.valuesPerNanosecond;
+        });
+    }
+
+    std::vector<size_t> threadCounts() {
+        const size_t hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+        std::vector<size_t> counts;
+        for (size_t count = 1; count < hardwareThreads; count *= 2) {
+            counts.push_back(count);
+        }
+        counts.push_back(hardwareThreads);
+        return counts;
+    }
+
+    void writeHeader(
+        std::ostream& output,
+        const std::string& distributionName,
+        const std::string& resultType,
+        const Engine& engine,
+        const Measurement& best)
+    {
+        const Configuration& configuration = best.configuration;
+        output << "// Generated by rng_cache_autotune for " << distributionName << " with " << engine.name << ",\n"
+               << "// measured at " << best.valuesPerNanosecond << " values/ns.\n"
+               << "//\n"
+               << "//     using namespace threaded_rng_cache;\n"
+               << "//     RngCache<Distribution, " << engine.name << ", tuned::CHUNK_SIZE> rngCache{\n"
+               << "//         distribution, std::nullopt, tuned::THREAD_COUNT, tuned::options()};\n"
+               << "#pragma once\n"
+               << "\n"
+               << "#include <threaded_rng_cache.hpp>\n";
+        if (!engine.header.empty()) {
+            output << "#include <" << engine.header << ">\n";
+        }
+        output << "\n"
+               << "namespace threaded_rng_cache::tuned {\n"
+               << "    inline constexpr size_t CHUNK_SIZE = " << configuration.chunkBytes << " / sizeof(" << resultType
+               << ");\n"
+               << "    inline constexpr size_t THREAD_COUNT = " << configuration.threadCount << ";\n"
+               << "    inline constexpr size_t QUEUE_DEPTH = " << configuration.queueDepth << ";\n"
+               << "\n"
+               << "    inline Options\n"
+               << "    options() {\n"
+               << "        Options options;\n"
+               << "        options.queueDepth = QUEUE_DEPTH;\n"
+               << "        return options;\n"
+               << "    }\n"
+               << "} // namespace threaded_rng_cache::tuned\n";
+    }
+
+    // The JSON is for scripts and records rather than for RngCache, which does not read it. It gives the chunk
+    // size both in bytes and in values as taken by Options::chunkSize.
+    void writeJson(
+        std::ostream& output,
+        const std::string& distributionName,
+        size_t resultSize,
+        const Engine& engine,
+        const Measurement& best)
+    {
+        const Configuration& configuration = best.configuration;
+        output << "{\n"
+               << "    \"distribution\": \"" << distributionName << "\",\n"
+               << "    \"engine\": \"" << engine.name << "\",\n"
+               << "    \"chunkSize\": " << configuration.chunkBytes / resultSize << ",\n"
+               << "    \"chunkBytes\": " << configuration.chunkBytes << ",\n"
+               << "    \"threadCount\": " << configuration.threadCount << ",\n"
+               << "    \"queueDepth\": " << configuration.queueDepth << ",\n"
+               << "    \"valuesPerNanosecond\": " << best.valuesPerNanosecond << "\n"
+               << "}\n";
+    }
+
+    template<typename EngineT, typename DistributionT>
+    void tune(
+        const DistributionT& distribution,
+        const std::string& distributionName,
+        const std::string& resultType,
+        const Engine& engine,
+        const Arguments& arguments)
+    {
+        std::vector<size_t> chunkSizes;
+        for (size_t chunkBytes = 16 * 1024; chunkBytes <= 1024 * 1024; chunkBytes *= 2) {
+            chunkSizes.push_back(chunkBytes);
+        }
+
+        Measurement best;
+        best = sweep<EngineT>(distribution, best.configuration, chunkSizes,
+            [](Configuration& configuration, size_t value){
+                configuration.chunkBytes = value;
+            }, arguments.values, false);
+        best = sweep<EngineT>(distribution, best.configuration, threadCounts(),
+            [](Configuration& configuration, size_t value){
+                configuration.threadCount = value;
+            }, arguments.values, true);
+        best = sweep<EngineT>(distribution, best.configuration, {1, 2, 4, 8},
+            [](Configuration& configuration, size_t value){
+                configuration.queueDepth = value;
+            }, arguments.values, true);
+
+        std::ofstream file;
+        if (!arguments.output.empty()) {
+            file.open(arguments.output);
+            if (!file) {
+                throw std::runtime_error{"Failed to open " + arguments.output + "."};
+            }
+        }
+        std::ostream& output = arguments.output.empty() ? std::cout : file;
+        if (arguments.format == "header") {
+            writeHeader(output, distributionName, resultType, engine, best);
+        } else {
+            writeJson(output, distributionName, sizeof(typename DistributionT::result_type), engine, best);
+        }
+    }
+
+    template<typename EngineT>
+    void tuneDistribution(const Engine& engine, const Arguments& arguments) {
+        if (arguments.distribution == "uniform_real") {
+            tune<EngineT>(std::uniform_real_distribution<double>{}, "std::uniform_real_distribution<double>",
+                          "double", engine, arguments);
+        } else if (arguments.distribution == "normal") {
+            tune<EngineT>(std::normal_distribution<double>{}, "std::normal_distribution<double>", "double", engine,
+                          arguments);
+        } else if (arguments.distribution == "uniform_int") {
+            tune<EngineT>(std::uniform_int_distribution<uint64_t>{}, "std::uniform_int_distribution<uint64_t>",
+                          "uint64_t", engine, arguments);
+        } else {
+            throw std::invalid_argument{"Unknown distribution " + arguments.distribution + "."};
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    try {
+        const Arguments arguments = parseArguments(argc, argv);
+        if (arguments.engine == "mt19937_64") {
+            tuneDistribution<std::mt19937_64>({"std::mt19937_64", ""}, arguments);
+        } else if (arguments.engine == "philox4x32") {
+            tuneDistribution<threaded_rng_cache::Philox4x32>(
+                {"threaded_rng_cache::Philox4x32", "threaded_rng_cache_engines.hpp"}, arguments);
+        } else if (arguments.engine == "threefry4x64") {
+            tuneDistribution<threaded_rng_cache::Threefry4x64>(
+                {"threaded_rng_cache::Threefry4x64", "threaded_rng_cache_engines.hpp"}, arguments);
+        } else {
+            throw std::invalid_argument{"Unknown engine " + arguments.engine + "."};
+        }
+    } catch (const std::exception& exception) {
+        std::cerr << "rng_cache_autotune: " << exception.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,9 +1,20 @@
 
 #include <threaded_rng_cache.hpp>
+#include <threaded_rng_cache_engines.hpp>
 
 #include <iostream>
 #include <chrono>
 #include <string>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 using Distribution = std::uniform_real_distribution<double>;
 using Results = std::vector<Distribution::result_type>;
@@ -59,12 +70,711 @@ namespace {
         std::optional<double> m_baseline;
         std::chrono::steady_clock::time_point m_begin;
     };
+
+    // A uniform distribution on [0, 1) that also converts a whole block of engine values per call, which the
+    // producers use instead of calling it once per value.
+    struct BatchUniformDistribution {
+        using result_type = double;
+
+        template<typename EngineT>
+        result_type operator()(EngineT& engine) const {
+            return static_cast<double>(engine() >> 11) * 0x1.0p-53;
+        }
+
+        template<typename EngineT>
+        void generate(std::span<result_type> values, EngineT& engine) const {
+            for (result_type& value : values) {
+                value = (*this)(engine);
+            }
+        }
+    };
+
+    // Philox4x32 without its batch generate, so that the producers draw from it one value at a time.
+    class ScalarPhilox4x32 {
+    public:
+        using result_type = threaded_rng_cache::Philox4x32::result_type;
+
+        explicit ScalarPhilox4x32(result_type seed)
+        : m_engine(seed)
+        {}
+
+        static constexpr result_type min() {
+            return threaded_rng_cache::Philox4x32::min();
+        }
+
+        static constexpr result_type max() {
+            return threaded_rng_cache::Philox4x32::max();
+        }
+
+        result_type operator()() {
+            return m_engine();
+        }
+
+    private:
+        threaded_rng_cache::Philox4x32 m_engine;
+    };
+
+    // Measures how fast a single producer fills its chunks, from starting a lazy cache with a deep queue until
+    // all of them are full. Includes faulting in the fresh chunk memory, which is the same for every case.
+    template<typename DistributionT, typename EngineT>
+    void runProducerFill(const DistributionT& distribution, size_t iterations, const std::string& name) {
+        const size_t chunkSize = 128 * 1024 / sizeof(typename DistributionT::result_type);
+        const size_t queueDepth = 64;
+        const size_t rounds = std::max<size_t>(iterations / (chunkSize * queueDepth), 1);
+
+        threaded_rng_cache::Options options;
+        options.lazyStart = true;
+        options.queueDepth = queueDepth;
+
+        std::chrono::duration<double, std::nano> duration{0};
+        for (size_t round = 0; round < rounds; ++round) {
+            threaded_rng_cache::RngCache<DistributionT, EngineT> rngCache{distribution, std::nullopt, 1, options};
+            const auto begin = std::chrono::steady_clock::now();
+            rngCache.wait_until_ready();
+            duration += std::chrono::steady_clock::now() - begin;
+        }
+        std::cout << "Producer fill, " << name << ": " << (rounds * chunkSize * queueDepth) / duration.count()
+                  << " values/ns." << std::endl;
+    }
+
+    // The producer fill rate calling the distribution once per value, drawing from a batch engine through a
+    // buffer and with a distribution generating whole blocks.
+    void runProducerFillRate(const Distribution& distribution, size_t iterations) {
+        runProducerFill<Distribution, std::mt19937_64>(distribution, iterations, "per value std::mt19937_64");
+        runProducerFill<Distribution, ScalarPhilox4x32>(distribution, iterations, "per value Philox4x32");
+        runProducerFill<Distribution, threaded_rng_cache::Philox4x32>(
+            distribution, iterations, "batch engine Philox4x32");
+        runProducerFill<BatchUniformDistribution, std::mt19937_64>({}, iterations, "batch distribution");
+    }
+
+    // Several consumer threads each filling their share of the results, either with a cache of their own or
+    // through handles to one shared cache.
+    void runMultipleConsumers(const Distribution& distribution, size_t iterations, double baseline) {
+        const size_t consumerCount = 4;
+        const size_t share = iterations / consumerCount;
+
+        const auto consume = [&](auto&& fillShare) {
+            Results results(share * consumerCount);
+            std::vector<std::thread> consumers;
+            for (size_t i = 0; i < consumerCount; ++i) {
+                consumers.emplace_back([&, i](){
+                    fillShare(std::span{results}.subspan(i * share, share));
+                });
+            }
+            for (std::thread& consumer : consumers) {
+                consumer.join();
+            }
+            return results;
+        };
+
+        {
+            Results results;
+            {
+                Timer timer{"RngCache per consumer thread", share * consumerCount, baseline};
+                results = consume([&](std::span<Distribution::result_type> output){
+                    threaded_rng_cache::RngCache rngCache{distribution};
+                    rngCache.fill(output);
+                });
+            }
+            touchResults(results);
+        }
+
+        {
+            threaded_rng_cache::RngCache rngCache{distribution};
+            Results results;
+            {
+                Timer timer{"RngCache shared through handles", share * consumerCount, baseline};
+                results = consume([&](std::span<Distribution::result_type> output){
+                    auto handle = rngCache.handle();
+                    handle.fill(output);
+                });
+            }
+            touchResults(results);
+        }
+    }
+
+    // One consumer drawing from many caches in turn, each cache either starting its own producer threads or
+    // having its chunks filled by the process-wide producer pool.
+    void runManyCaches(const Distribution& distribution, size_t iterations, double baseline) {
+        using Cache = threaded_rng_cache::RngCache<Distribution>;
+        const size_t cacheCount = 16;
+        const size_t blockSize = 4096;
+        const size_t blocks = iterations / (cacheCount * blockSize);
+
+        const auto consume = [&](const std::string& name, const threaded_rng_cache::Options& options) {
+            std::vector<std::unique_ptr<Cache>> caches;
+            for (size_t i = 0; i < cacheCount; ++i) {
+                caches.push_back(std::make_unique<Cache>(distribution, std::nullopt, std::nullopt, options));
+            }
+            Results results(blocks * cacheCount * blockSize);
+            {
+                Timer timer{name, results.size(), baseline};
+                auto output = results.begin();
+                for (size_t block = 0; block < blocks; ++block) {
+                    for (const auto& cache : caches) {
+                        output = cache->generate_n(output, blockSize);
+                    }
+                }
+            }
+            touchResults(results);
+        };
+
+        consume("16 RngCaches with own threads", {});
+
+        threaded_rng_cache::Options pooled;
+        pooled.pool = threaded_rng_cache::ProducerPool::global();
+        consume("16 RngCaches on the global pool", pooled);
+    }
+
+    // The default single consumer throughput with the producer threads placed according to each policy.
+    void runAffinityPolicies(const Distribution& distribution, size_t iterations, double baseline) {
+        using Policy = threaded_rng_cache::Affinity::Policy;
+        const std::pair<Policy, std::string> policies[] = {
+            {Policy::None, "no affinity"},
+            {Policy::AvoidConsumerCore, "avoid consumer core"},
+            {Policy::ConsumerSibling, "consumer SMT sibling"},
+            {Policy::OnePerPhysicalCore, "one per physical core"},
+        };
+
+        for (const auto& [policy, name] : policies) {
+            threaded_rng_cache::Options options;
+            options.affinity.policy = policy;
+            threaded_rng_cache::RngCache rngCache{distribution, std::nullopt, std::nullopt, options};
+
+            Results results(iterations);
+            {
+                Timer timer{"RngCache, " + name, iterations, baseline};
+                rngCache.fill(results);
+            }
+            touchResults(results);
+        }
+    }
+
+    // Throughput with the chunk memory placed according to each NUMA policy, along with the share of chunk
+    // pages the consumer found on a remote node.
+    void runNumaPolicies(const Distribution& distribution, size_t iterations, double baseline) {
+        using Policy = threaded_rng_cache::Numa::Policy;
+        const std::pair<Policy, std::string> policies[] = {
+            {Policy::FirstTouch, "first touch"},
+            {Policy::ConsumerNode, "consumer node"},
+            {Policy::Interleave, "interleaved"},
+        };
+
+        for (const auto& [policy, name] : policies) {
+            threaded_rng_cache::Options options;
+            options.numa.policy = policy;
+            options.numa.statistics = true;
+            threaded_rng_cache::RngCache rngCache{distribution, std::nullopt, std::nullopt, options};
+
+            Results results(iterations);
+            {
+                Timer timer{"RngCache, " + name, iterations, baseline};
+                rngCache.fill(results);
+            }
+            touchResults(results);
+
+            const threaded_rng_cache::Statistics& statistics = rngCache.statistics();
+            size_t pages = 0;
+            std::cout << "Chunk pages by node:";
+            for (size_t node = 0; node < statistics.pagesByNode.size(); ++node) {
+                std::cout << " " << node << ": " << statistics.pagesByNode[node];
+                pages += statistics.pagesByNode[node];
+            }
+            std::cout << ", " << statistics.remotePages << " of " << pages << " remote." << std::endl;
+        }
+    }
+
+    // Counts the data TLB load misses of the calling thread while alive, where the kernel allows it.
+    class DtlbMissCounter {
+    public:
+        DtlbMissCounter()
+        : m_fd(-1)
+        {
+#if defined(__linux__)
+            perf_event_attr attributes{};
+            attributes.type = PERF_TYPE_HW_CACHE;
+            attributes.size = sizeof(attributes);
+            attributes.config = PERF_COUNT_HW_CACHE_DTLB
+                | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            attributes.disabled = 1;
+            attributes.exclude_kernel = 1;
+            attributes.exclude_hv = 1;
+            m_fd = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+            if (m_fd >= 0) {
+                ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+        }
+
+        ~DtlbMissCounter() {
+#if defined(__linux__)
+            if (m_fd >= 0) {
+                close(m_fd);
+            }
+#endif
+        }
+
+        std::optional<uint64_t> misses() const {
+#if defined(__linux__)
+            uint64_t count = 0;
+            if (m_fd >= 0 && read(m_fd, &count, sizeof(count)) == sizeof(count)) {
+                return count;
+            }
+#endif
+            return std::nullopt;
+        }
+
+    private:
+        int m_fd;
+    };
+
+    // The consumer sweeping through fresh chunks backed by regular, transparent huge and explicit huge pages.
+    void runHugePages(const Distribution& distribution, size_t iterations, double baseline) {
+        using threaded_rng_cache::HugePages;
+        const std::pair<HugePages, std::string> modes[] = {
+            {HugePages::None, "regular pages"},
+            {HugePages::Transparent, "transparent huge pages"},
+            {HugePages::Explicit, "explicit huge pages"},
+        };
+
+        for (const auto& [hugePages, name] : modes) {
+            threaded_rng_cache::Options options;
+            options.hugePages = hugePages;
+            threaded_rng_cache::RngCache rngCache{distribution, std::nullopt, std::nullopt, options};
+
+            Results results(iterations);
+            std::optional<uint64_t> misses;
+            {
+                Timer timer{"RngCache, " + name, iterations, baseline};
+                DtlbMissCounter counter;
+                for (auto& result : results) {
+                    result = rngCache();
+                }
+                misses = counter.misses();
+            }
+            touchResults(results);
+
+            std::cout << "dTLB load misses: ";
+            if (misses) {
+                const double perThousand = static_cast<double>(*misses) * 1000.0 / static_cast<double>(iterations);
+                std::cout << *misses << " (" << perThousand << " per 1000 values).";
+            } else {
+                std::cout << "not available.";
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    // Writes every page of its allocations before handing them out, so that nobody takes the page faults later.
+    template<typename T>
+    class PrefaultingAllocator {
+    public:
+        using value_type = T;
+
+        PrefaultingAllocator() = default;
+
+        template<typename U>
+        PrefaultingAllocator(const PrefaultingAllocator<U>&) noexcept
+        {}
+
+        T* allocate(size_t count) {
+            T* memory = std::allocator<T>{}.allocate(count);
+            std::memset(static_cast<void*>(memory), 0, count * sizeof(T));
+            return memory;
+        }
+
+        void deallocate(T* memory, size_t count) noexcept {
+            std::allocator<T>{}.deallocate(memory, count);
+        }
+
+        template<typename U>
+        bool operator==(const PrefaultingAllocator<U>&) const noexcept {
+            return true;
+        }
+    };
+
+    template<typename AllocatorT>
+    void runAllocator(const Distribution& distribution, size_t iterations, double baseline, const std::string& name) {
+        threaded_rng_cache::RngCache<Distribution, std::mt19937_64, 128 * 1024 / sizeof(double), AllocatorT>
+            rngCache{distribution};
+
+        Results results(iterations);
+        {
+            Timer timer{"RngCache, " + name, iterations, baseline};
+            for (auto& result : results) {
+                result = rngCache();
+            }
+        }
+        touchResults(results);
+    }
+
+    // The chunks allocated with the default page allocator, from the heap, and from memory faulted in up front.
+    void runAllocators(const Distribution& distribution, size_t iterations, double baseline) {
+        runAllocator<threaded_rng_cache::PageAllocator<double>>(distribution, iterations, baseline, "PageAllocator");
+        runAllocator<std::allocator<double>>(distribution, iterations, baseline, "std::allocator");
+        runAllocator<PrefaultingAllocator<double>>(distribution, iterations, baseline, "prefaulting allocator");
+    }
+
+    // The slowest single call while consuming the first chunks of a freshly constructed cache, with and without
+    // faulting in and locking the chunk memory up front.
+    void runPrefault(const Distribution& distribution) {
+        threaded_rng_cache::Options prefault;
+        prefault.prefault = true;
+        threaded_rng_cache::Options lockMemory;
+        lockMemory.lockMemory = true;
+        const std::pair<threaded_rng_cache::Options, std::string> modes[] = {
+            {{}, "default"},
+            {prefault, "prefault"},
+            {lockMemory, "lockMemory"},
+        };
+        const size_t values = 4 * std::thread::hardware_concurrency() * 128 * 1024 / sizeof(Distribution::result_type);
+
+        for (const auto& [options, name] : modes) {
+            threaded_rng_cache::RngCache rngCache{distribution, std::nullopt, std::nullopt, options};
+
+            Results results(values);
+            std::chrono::steady_clock::duration worst{0};
+            for (auto& result : results) {
+                const auto begin = std::chrono::steady_clock::now();
+                result = rngCache();
+                worst = std::max(worst, std::chrono::steady_clock::now() - begin);
+            }
+            touchResults(results);
+
+            const std::chrono::duration<double, std::micro> worstMicroseconds = worst;
+            std::cout << "First chunks, " << name << ": slowest call " << worstMicroseconds << "." << std::endl;
+        }
+    }
+
+    // How long construction takes and how long the first value then takes, with and without prefilling.
+    void runTimeToFirstValue(const Distribution& distribution) {
+        for (bool prefill : {false, true}) {
+            threaded_rng_cache::Options options;
+            options.prefill = prefill;
+
+            const auto begin = std::chrono::steady_clock::now();
+            threaded_rng_cache::RngCache rngCache{distribution, std::nullopt, std::nullopt, options};
+            const auto constructed = std::chrono::steady_clock::now();
+            const Distribution::result_type value = rngCache();
+            const auto firstValue = std::chrono::steady_clock::now();
+
+            const std::chrono::duration<double, std::micro> construction = constructed - begin;
+            const std::chrono::duration<double, std::micro> first = firstValue - constructed;
+            std::cout << "Time to first value, " << (prefill ? "prefill" : "default") << ": construction "
+                      << construction << ", first value " << first << " (" << value << ")." << std::endl;
+        }
+    }
+
+    // Constructs and destroys caches that are never used or only asked for a single value, starting the
+    // producers up front and then lazily, with dedicated threads and on a shared pool, compared against the
+    // former.
+    void runConstruction(const Distribution& distribution) {
+        const size_t caches = 100;
+        double unused = 0.0;
+        double singleValue = 0.0;
+
+        const auto measure = [&](const threaded_rng_cache::Options& options, const std::string& mode, auto&& timer) {
+            {
+                auto unusedTimer = timer("Construction and teardown, " + mode, unused);
+                for (size_t i = 0; i < caches; ++i) {
+                    threaded_rng_cache::RngCache rngCache{distribution, std::nullopt, std::nullopt, options};
+                }
+            }
+            Distribution::result_type sum = 0.0;
+            {
+                auto singleValueTimer = timer("Construction, one value and teardown, " + mode, singleValue);
+                for (size_t i = 0; i < caches; ++i) {
+                    threaded_rng_cache::RngCache rngCache{distribution, std::nullopt, std::nullopt, options};
+                    sum += rngCache();
+                }
+            }
+            std::cout << "Produced sum: " << sum << std::endl;
+        };
+
+        threaded_rng_cache::Options lazyStart;
+        lazyStart.lazyStart = true;
+        threaded_rng_cache::Options pooledLazyStart = lazyStart;
+        pooledLazyStart.pool = std::make_shared<threaded_rng_cache::ProducerPool>(2);
+
+        measure({}, "eager start", [&](std::string name, double& result){
+            return Timer{std::move(name), caches, &result};
+        });
+        measure(lazyStart, "lazy start", [&](std::string name, double& baseline){
+            return Timer{std::move(name), caches, baseline};
+        });
+        measure(pooledLazyStart, "lazy start on a pool", [&](std::string name, double& baseline){
+            return Timer{std::move(name), caches, baseline};
+        });
+    }
+
+    // Continuous consumption on an adaptive pool that may use up to one worker per hardware thread, reporting
+    // how many workers it settled on.
+    void runAdaptiveThreads(const Distribution& distribution, size_t iterations, double baseline) {
+        const size_t threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+        const auto pool =
+            std::make_shared<threaded_rng_cache::ProducerPool>(1, threadCount, threaded_rng_cache::Affinity{});
+        threaded_rng_cache::Options options;
+        options.pool = pool;
+        threaded_rng_cache::RngCache rngCache{distribution, std::nullopt, threadCount, options};
+
+        Results results(iterations);
+        {
+            Timer timer{"RngCache, adaptive pool", iterations, baseline};
+            for (auto& result : results) {
+                result = rngCache();
+            }
+        }
+        touchResults(results);
+
+        const threaded_rng_cache::Statistics& statistics = rngCache.statistics();
+        std::cout << "Adaptive pool: " << pool->activeThreadCount() << " of " << pool->threadCount()
+                  << " workers active, " << statistics.stalls << " of " << statistics.swaps << " swaps stalled."
+                  << std::endl;
+    }
+
+    // The chunk size chosen at runtime from the L2 cache size, against the fixed size of the cases above.
+    void runRuntimeChunkSize(const Distribution& distribution, size_t iterations, double baseline) {
+        threaded_rng_cache::RngCache<Distribution, std::mt19937_64, std::dynamic_extent> rngCache{distribution};
+
+        Results results(iterations);
+        const std::string name = "RngCache, runtime chunk size of " + std::to_string(rngCache.chunk_size());
+        {
+            Timer timer{name, iterations, baseline};
+            for (auto& result : results) {
+                result = rngCache();
+            }
+        }
+        touchResults(results);
+    }
+
+    template<typename WaitPolicyT>
+    void runWaitPolicy(const Distribution& distribution, size_t iterations, double baseline, const std::string& name) {
+        threaded_rng_cache::RngCache<
+            Distribution,
+            std::mt19937_64,
+            128 * 1024 / sizeof(double),
+            threaded_rng_cache::PageAllocator<double>,
+            WaitPolicyT> rngCache{distribution};
+
+        Results results(iterations);
+        {
+            Timer timer{"RngCache, " + name, iterations, baseline};
+            for (auto& result : results) {
+                result = rngCache();
+            }
+        }
+        touchResults(results);
+
+        const threaded_rng_cache::Statistics& statistics = rngCache.statistics();
+        std::cout << name << ": " << statistics.stalls << " of " << statistics.swaps << " swaps stalled, "
+                  << statistics.fallbacks << " values from the fallback engine." << std::endl;
+    }
+
+    // The consumer waiting for chunks still being filled by blocking, spinning, spinning before blocking, or not
+    // at all by falling back to an engine of its own.
+    void runWaitPolicies(const Distribution& distribution, size_t iterations, double baseline) {
+        runWaitPolicy<threaded_rng_cache::BlockingWait>(distribution, iterations, baseline, "BlockingWait");
+        runWaitPolicy<threaded_rng_cache::SpinWait>(distribution, iterations, baseline, "SpinWait");
+        runWaitPolicy<threaded_rng_cache::HybridWait<>>(distribution, iterations, baseline, "HybridWait");
+        runWaitPolicy<threaded_rng_cache::NonBlockingWait>(distribution, iterations, baseline, "NonBlockingWait");
+    }
+
+    // Asks for every value with a timeout, as a request handler with a latency budget would, and counts how
+    // often the cache could not deliver in time.
+    void runDeadlines(const Distribution& distribution, size_t iterations, double baseline) {
+        using namespace std::chrono_literals;
+        const std::pair<std::chrono::microseconds, std::string> timeouts[] = {
+            {0us, "0 µs"},
+            {10us, "10 µs"},
+            {100us, "100 µs"},
+        };
+
+        for (const auto& [timeout, name] : timeouts) {
+            threaded_rng_cache::RngCache rngCache{distribution};
+
+            Results results(iterations);
+            size_t missed = 0;
+            {
+                Timer timer{"RngCache::generate_for, timeout " + name, iterations, baseline};
+                for (auto& result : results) {
+                    const std::optional<Distribution::result_type> value = rngCache.generate_for(timeout);
+                    if (value) {
+                        result = *value;
+                    } else {
+                        ++missed;
+                    }
+                }
+            }
+            touchResults(results);
+            std::cout << "Timeout " << name << ": " << missed << " of " << iterations << " values missed."
+                      << std::endl;
+        }
+    }
+
+    // Wraps a distribution and occasionally stalls the producer calling it for a millisecond, as a page fault,
+    // preemption or expensive rejection loop would.
+    struct HiccupDistribution {
+        using result_type = Distribution::result_type;
+
+        Distribution distribution;
+
+        template<typename EngineT>
+        result_type operator()(EngineT& engine) {
+            const result_type value = distribution(engine);
+            if (value < 1e-6) {
+                std::this_thread::sleep_for(std::chrono::milliseconds{1});
+            }
+            return value;
+        }
+    };
+
+    // Consumes from producers that occasionally stall, in each ordering, and reports how often the consumer had
+    // to wait for a chunk.
+    void runOrdering(const Distribution& distribution, size_t iterations, double baseline) {
+        const std::pair<threaded_rng_cache::Ordering, std::string> orderings[] = {
+            {threaded_rng_cache::Ordering::RoundRobin, "round-robin"},
+            {threaded_rng_cache::Ordering::Unordered, "unordered"},
+            {threaded_rng_cache::Ordering::Sequenced, "sequenced"},
+        };
+
+        for (const auto& [ordering, name] : orderings) {
+            threaded_rng_cache::Options options;
+            options.ordering = ordering;
+            threaded_rng_cache::RngCache rngCache{
+                HiccupDistribution{distribution}, std::nullopt, std::nullopt, options};
+
+            Results results(iterations);
+            {
+                Timer timer{"RngCache with stalling producers, " + name, iterations, baseline};
+                rngCache.fill(results);
+            }
+            touchResults(results);
+
+            const threaded_rng_cache::Statistics& statistics = rngCache.statistics();
+            std::cout << "Ordering " << name << ": " << statistics.stalls << " of " << statistics.swaps
+                      << " swaps stalled." << std::endl;
+        }
+    }
+
+    // Runs a sequenced cache with a fixed seed at several thread counts and chunk sizes, checking that they all
+    // produce the same values as the first, and compares their speed with the default ordering. Returns false if
+    // any of them differs.
+    bool runSequenced(const Distribution& distribution, size_t iterations, double baseline) {
+        const size_t hardwareThreads = std::thread::hardware_concurrency();
+        const std::pair<size_t, size_t> configurations[] = {
+            {1, 16 * 1024},
+            {3, 16 * 1024},
+            {hardwareThreads, 16 * 1024},
+            {hardwareThreads, 5000},
+        };
+
+        Results reference;
+        bool identical = true;
+        for (const auto& [threadCount, chunkSize] : configurations) {
+            threaded_rng_cache::Options options;
+            options.ordering = threaded_rng_cache::Ordering::Sequenced;
+            options.chunkSize = chunkSize;
+            threaded_rng_cache::RngCache<Distribution, std::mt19937_64, std::dynamic_extent> rngCache{
+                distribution, std::optional<uint64_t>{42}, threadCount, options};
+
+            const std::string name = std::to_string(threadCount) + " threads, chunk size " + std::to_string(chunkSize);
+            Results results(iterations);
+            {
+                Timer timer{"RngCache sequenced, " + name, iterations, baseline};
+                rngCache.fill(results);
+            }
+            touchResults(results);
+
+            if (reference.empty()) {
+                reference = std::move(results);
+                continue;
+            }
+            const auto [mismatch, referenceMismatch] = std::ranges::mismatch(results, reference);
+            if (mismatch != results.end()) {
+                identical = false;
+                std::cout << "Sequenced output with " << name << " differs from the first configuration at value "
+                          << std::distance(results.begin(), mismatch) << ": " << *mismatch << " instead of "
+                          << *referenceMismatch << "." << std::endl;
+            }
+        }
+        return identical;
+    }
+
+    // Generates values with the engine directly and through a sequenced cache, which reseeds std::mt19937_64 for
+    // every block of the sequence but only moves counter-based engines to the block's stream.
+    template<typename EngineT>
+    void runEngine(const Distribution& distribution, size_t iterations, double baseline, const std::string& name) {
+        {
+            EngineT engine{42};
+            Distribution engineDistribution = distribution;
+
+            Results results(iterations);
+            {
+                Timer timer{"Engine " + name, iterations, baseline};
+                for (auto& result : results) {
+                    result = engineDistribution(engine);
+                }
+            }
+            touchResults(results);
+        }
+        {
+            threaded_rng_cache::Options options;
+            options.ordering = threaded_rng_cache::Ordering::Sequenced;
+            threaded_rng_cache::RngCache<Distribution, EngineT> rngCache{
+                distribution, std::nullopt, std::nullopt, options};
+
+            Results results(iterations);
+            {
+                Timer timer{"RngCache sequenced with " + name, iterations, baseline};
+                rngCache.fill(results);
+            }
+            touchResults(results);
+        }
+    }
+
+    void runEngines(const Distribution& distribution, size_t iterations, double baseline) {
+        runEngine<std::mt19937_64>(distribution, iterations, baseline, "std::mt19937_64");
+        runEngine<threaded_rng_cache::Philox4x32>(distribution, iterations, baseline, "Philox4x32");
+        runEngine<threaded_rng_cache::Threefry4x64>(distribution, iterations, baseline, "Threefry4x64");
+    }
+
+    // Consumes values in bursts of several chunks per producer separated by idle periods in which the producers
+    // can catch up, and reports how often the consumer had to wait for a chunk at each queue depth.
+    void runBurstyConsumption(const Distribution& distribution) {
+        const size_t threadCount = std::thread::hardware_concurrency();
+        const size_t bursts = 50;
+        const size_t burstSize = 4 * threadCount * 128 * 1024 / sizeof(Distribution::result_type);
+        const auto idle = std::chrono::milliseconds{10};
+
+        for (size_t queueDepth : {1, 2, 4, 8}) {
+            threaded_rng_cache::Options options;
+            options.queueDepth = queueDepth;
+            threaded_rng_cache::RngCache rngCache{distribution, std::nullopt, threadCount, options};
+
+            Results results(burstSize);
+            std::chrono::duration<double> busy{0};
+            for (size_t burst = 0; burst < bursts; ++burst) {
+                std::this_thread::sleep_for(idle);
+                const auto begin = std::chrono::steady_clock::now();
+                rngCache.fill(results);
+                busy += std::chrono::steady_clock::now() - begin;
+            }
+
+            const threaded_rng_cache::Statistics& statistics = rngCache.statistics();
+            const std::chrono::duration<double, std::nano> durationPerElement = busy / (bursts * burstSize);
+            std::cout << "Bursty consumption, queue depth " << queueDepth << ": "
+                      << statistics.stalls << " of " << statistics.swaps << " swaps stalled ("
+                      << durationPerElement << " per iteration)." << std::endl;
+        }
+    }
 }
 
-int main() {
+int main(int argc, char** argv) {
 
     const Distribution commonDistribution{0.0, 1.0};
-    const size_t iterations = 1'000'000'000;
+    const size_t iterations = argc > 1 ? std::stoull(argv[1]) : 1'000'000'000;
 
     double baselineResult = 0.0;
 
@@ -102,6 +812,38 @@ int main() {
         touchResults(results);
     }
 
+    {
+        Distribution distribution = commonDistribution;
+        threaded_rng_cache::RngCache rngCache{distribution};
+
+        Results results(iterations);
+
+        {
+            Timer timer{"RngCache::fill", iterations, baselineResult};
+            rngCache.fill(results);
+        }
+
+        touchResults(results);
+    }
+
+    runProducerFillRate(commonDistribution, iterations);
+    runMultipleConsumers(commonDistribution, iterations, baselineResult);
+    runManyCaches(commonDistribution, iterations, baselineResult);
+    runAffinityPolicies(commonDistribution, iterations, baselineResult);
+    runNumaPolicies(commonDistribution, iterations, baselineResult);
+    runHugePages(commonDistribution, iterations, baselineResult);
+    runAllocators(commonDistribution, iterations, baselineResult);
+    runPrefault(commonDistribution);
+    runTimeToFirstValue(commonDistribution);
+    runConstruction(commonDistribution);
+    runAdaptiveThreads(commonDistribution, iterations, baselineResult);
+    runRuntimeChunkSize(commonDistribution, iterations, baselineResult);
+    runWaitPolicies(commonDistribution, iterations, baselineResult);
+    runDeadlines(commonDistribution, iterations, baselineResult);
+    runOrdering(commonDistribution, iterations, baselineResult);
+    const bool sequencedIdentical = runSequenced(commonDistribution, iterations, baselineResult);
+    runEngines(commonDistribution, iterations, baselineResult);
+    runBurstyConsumption(commonDistribution);
 
-    return 0;
+    return sequencedIdentical ? 0 : 1;
 }